@@ -0,0 +1,123 @@
+/*
+Copyright 2026 Spalishe
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#pragma once
+#include "decode.hpp"
+#include "memory_map.hpp"
+#include "mmu.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct Hart;
+
+static constexpr uint32_t BLOCK_MAX_OPS	   = 64;
+static constexpr uint32_t BLOCK_CACHE_SIZE = 16384;
+// All blocks are dropped at once when their ops outgrow this
+static constexpr size_t BLOCK_ARENA_OPS = 1 << 20;
+// Decoded pages are all dropped when their count outgrows this
+static constexpr size_t DECODE_MAX_PAGES = 4096;
+
+struct PredecodedOp
+{
+	ExecReturn (*func)(Hart& h, InstructionData& data);
+	InstructionData data;
+	uint8_t size;
+	bool sync;		   // Touches CSRs or privilege state, counters must be exact before it runs
+	uint8_t insts = 1; // Instructions it retires, 2 for fused pair
+};
+
+// Straight-line run of instructions inside one physical page, ending at first control transfer or system instruction
+struct CodeBlock
+{
+	uint64_t paddr = ~0ULL;
+	uint32_t gen   = 0; // Write generation of page at decode time
+	uint32_t page  = 0; // DRAM page index
+	uint32_t first = 0; // Index of first op in arena
+	uint32_t count = 0;
+};
+
+struct BlockCache
+{
+	CodeBlock blocks[BLOCK_CACHE_SIZE];
+	std::vector<PredecodedOp> ops;
+
+	// Block starting at physical address, decoded on miss. nullptr if code there can't be pre-decoded
+	inline CodeBlock* lookup(const InstructionDecoder* idec, MemoryMap* mmap, uint64_t paddr)
+	{
+		CodeBlock& blk = blocks[(paddr >> 1) & (BLOCK_CACHE_SIZE - 1)];
+		if(blk.paddr == paddr && blk.gen == mmap->page_gen[blk.page].load(std::memory_order_relaxed)) [[likely]]
+			return &blk;
+		return build(idec, mmap, blk, paddr);
+	}
+	void flush();
+
+  private:
+	CodeBlock* build(const InstructionDecoder* idec, MemoryMap* mmap, CodeBlock& blk, uint64_t paddr);
+};
+
+// Instructions of one DRAM page decoded so far, entries are added as they are executed
+struct DecodedPage
+{
+	// Index + 1 of entry for instruction starting at each halfword, 0 if it was never decoded
+	uint16_t slot[PAGE_SIZE / 2] = { 0 };
+	std::vector<InstructionCache> entries;
+};
+
+// Decoded instructions of one hart for single stepping, keyed by physical address. Entry is valid
+// while its generation matches page_gen of its page, so hit skips both fetch and decode
+struct DecodeCache
+{
+	std::unordered_map<uint32_t, DecodedPage*> pages;
+	DecodedPage* last	= nullptr;
+	uint32_t last_page	= ~0u;
+	// Holds instructions that can't be cached, valid until next decode
+	InstructionCache scratch;
+
+	DecodeCache() = default;
+	DecodeCache(const DecodeCache&)			   = delete;
+	DecodeCache& operator=(const DecodeCache&) = delete;
+	~DecodeCache()
+	{
+		flush();
+	}
+
+	// Decoded instruction at physical address, nullptr if it is outside of DRAM or crosses page
+	inline InstructionCache* lookup(const InstructionDecoder* idec, MemoryMap* mmap, uint64_t paddr)
+	{
+		MemoryRegion* ram = mmap->ram_direct;
+		uint64_t off	  = paddr - ram->base_addr;
+		if(off >= ram->size) [[unlikely]]
+			return nullptr;
+		uint32_t page = off >> PAGE_SHIFT;
+		if(page != last_page) [[unlikely]]
+			get_page(page);
+		uint16_t idx = last->slot[(off & (PAGE_SIZE - 1)) >> 1];
+		if(idx != 0) [[likely]]
+		{
+			InstructionCache& entry = last->entries[idx - 1];
+			if(entry.gen == mmap->page_gen[page].load(std::memory_order_relaxed)) [[likely]]
+				return &entry;
+		}
+		return decode(idec, mmap, off);
+	}
+	void flush();
+
+  private:
+	void get_page(uint32_t page);
+	InstructionCache* decode(const InstructionDecoder* idec, MemoryMap* mmap, uint64_t off);
+};
@@ -19,7 +19,6 @@ Copyright 2026 Spalishe
 #include "defines/traps.hpp"
 #include <array>
 #include <cstdint>
-#include <immintrin.h>
 #include <string>
 #include <vector>
 
@@ -191,69 +190,46 @@ struct Instruction
 
 struct InstructionCache
 {
-	uint64_t pc;
 	uint32_t inst_raw = 0;
+	uint32_t gen	  = 0; // Write generation of code page at decode time
 	const Instruction* inst;
 	InstructionData data;
 	bool valid = false;
 };
 
-struct CacheSet
-{
-	InstructionCache ways[2];
-	uint8_t victim;
-};
-
-static constexpr uint32_t CACHE_SIZE = 65536;
 struct InstructionDecoder
 {
 	std::vector<Instruction> instructions;
 
-	static constexpr size_t LUT_SIZE	= 1 << 22;
-	const Instruction* lut[LUT_SIZE]	= { nullptr };
-	static constexpr uint32_t HASH_MASK = 0xFFF0707F;
+	// Two-level table, 32-bit encodings are looked up by major opcode (bits 6:0) and then funct3 (bits 14:12),
+	// compressed ones by quadrant (bits 1:0) and then funct3 (bits 15:13). Bucket lists its candidates most specific first
+	static constexpr uint32_t BUCKETS_32 = 128 * 8;
+	static constexpr uint32_t BUCKETS_16 = 4 * 8;
+	static constexpr uint32_t BUCKETS	 = BUCKETS_32 + BUCKETS_16;
+	uint32_t bucket_start[BUCKETS + 1] = { 0 };
+	std::vector<const Instruction*> candidates;
 
-	static constexpr size_t LUT_SIZE_16	   = 1 << 16;
-	const Instruction* lut16[LUT_SIZE_16]  = { nullptr };
-	static constexpr uint32_t HASH_MASK_16 = 0x0000FFFF;
-
-	CacheSet cache[CACHE_SIZE];
-
-	InstructionCache& decode_inst_slow(uint64_t pc, uint32_t inst);
-	inline InstructionCache& decode_inst(uint64_t pc, uint32_t inst)
+	static inline uint32_t bucket_index(uint32_t inst)
 	{
-		size_t idx	  = (pc >> 2) & (CACHE_SIZE - 1);
-		/*if(cache[idx].valid && cache[idx].pc == pc) [[likely]]
-		{
-			hit++;
-			return cache[idx];
-		}*/
-		CacheSet& set = cache[idx];
-
-		if(set.ways[0].valid && set.ways[0].pc == pc && set.ways[0].inst_raw == inst)
-		{
-			return set.ways[0];
-		}
+		if((inst & 0x3) != 0x3)
+			return BUCKETS_32 + (((inst & 0x3) << 3) | ((inst >> 13) & 0x7));
+		return ((inst & 0x7F) << 3) | ((inst >> 12) & 0x7);
+	}
 
-		if(set.ways[1].valid && set.ways[1].pc == pc && set.ways[1].inst_raw == inst)
-		{
-			return set.ways[1];
-		}
+	// Decoder shared by every machine in process, built on first call and read-only afterwards
+	static const InstructionDecoder* shared();
 
-		return decode_inst_slow(pc, inst);
-	}
+	// Instruction matching this encoding, nullptr if there is none
+	const Instruction* find_inst(uint32_t inst) const;
+	static InstructionData decode_data(const Instruction* dinst, uint32_t inst);
+	// 32-bit equivalent of compressed instruction, 0 if it has none or is reserved. Control transfers aren't
+	// expanded, their link and fall-through addresses depend on instruction size
+	static uint32_t expand_compressed(uint16_t inst);
+	// Decodes into entry, entry.valid is false for illegal instruction
+	void decode_into(InstructionCache& entry, uint32_t inst) const;
 
-	uint32_t global_hash_mask = 0;
-	void build_lut();
+	void build_table();
 	void register_instr(std::string mask, ExecReturn (*func)(Hart&, InstructionData&), uint64_t (*imm_decode_func)(uint32_t inst) = NULL);
-	static inline uint32_t get_lut_index(uint32_t inst)
-	{
-		return _pext_u32(inst, HASH_MASK);
-	}
-	static inline uint32_t get_lut_index16(uint32_t inst)
-	{
-		return _pext_u32(inst, HASH_MASK_16);
-	}
 	// This function will call on init, calling all sets functions to initialize
 	void init_all_instrs();
 	void init_rv64i();
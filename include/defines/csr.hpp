@@ -18,6 +18,9 @@ Copyright 2026 Spalishe
 #pragma once
 #include <cstdint>
 
+// Size of CSR address space
+#define CSR_COUNT 4096
+
 // User Floating-Point CSRs
 #define CSR_FFLAGS 0x001 // URW Floating-Point Accrued Exceptions.
 #define CSR_FRM	   0x002 // URW Floating-Point Dynamic Rounding Mode.
@@ -367,6 +370,10 @@ Copyright 2026 Spalishe
 
 #define SSTATUS_MASK	 0x80000003000DE762ULL
 #define SE_MASK			 0x222
+// mip bits software may write, MSIP, MTIP and MEIP only follow CLINT and PLIC
+#define MIP_WRITE_MASK	 ((1 << MIP_SSIP) | (1 << MIP_STIP) | (1 << MIP_SEIP))
+// sip.SEIP can only be set through mip
+#define SIP_WRITE_MASK	 (SE_MASK & ~(1 << MIP_SEIP))
 
 union ip_t
 {
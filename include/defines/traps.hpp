@@ -33,6 +33,8 @@ Copyright 2026 Spalishe
 #define EXC_INST_PAGE_FAULT		  12
 #define EXC_LOAD_PAGE_FAULT		  13
 #define EXC_STORE_PAGE_FAULT	  15
+// Not a guest exception: access has to wait for serial phase of deterministic SMP, instruction runs again there
+#define EXC_SYNC_DEFER			  63
 
 // Interrupt cause codes (these are the Exception_Code field when Interrupt bit
 // = 1)
@@ -19,6 +19,7 @@ Copyright 2026 Spalishe
 #include "libfdt.hpp"
 #include "memory_map.hpp"
 #include <cstdint>
+#include <mutex>
 
 struct Machine;
 
@@ -31,6 +32,8 @@ struct Device : std::enable_shared_from_this<Device>
 	uint64_t start;
 	uint64_t size;
 	uint64_t end;
+	// Held around read(), write() and tick(), harts and host threads reach device concurrently
+	std::mutex lock;
 
 	virtual uint64_t read(uint64_t addr, MemorySize size) { return 0; }
 	virtual void write(uint64_t addr, MemorySize size, uint64_t val) {}
@@ -22,6 +22,8 @@ Copyright 2026 Spalishe
 #include <atomic>
 #include <thread>
 
+struct Hart;
+
 #define CLINT_MSWI_SIZE	  0x4000
 #define CLINT_MTIMER_SIZE 0x8000
 
@@ -41,6 +43,8 @@ struct CLINT : public Device
 	std::thread thr;
 	std::atomic<bool> thr_working;
 	uint64_t countr;
+	// mtime follows Machine::virtual_ns and is updated from tick() instead of thread
+	bool virtual_time;
 
 	Machine& cpu;
 
@@ -48,11 +52,15 @@ struct CLINT : public Device
 	void write(uint64_t addr, MemorySize size, uint64_t val);
 	void tick();
 	static std::shared_ptr<CLINT> init_auto(Machine& cpu);
+	// Points harts at this clock, called again for harts created by machine reset
+	void attach_harts();
 
 	uint64_t read_mswi(uint64_t offset);
 	uint64_t read_mtimer(uint64_t offset);
 	void write_mswi(uint64_t offset, uint64_t value);
 	void write_mtimer(uint64_t offset, uint64_t value);
 	void update_mip();
+	// Host nanoseconds until enabled timer interrupt of hart is due, UINT64_MAX if none is armed or all already raised
+	uint64_t next_timer_ns(Hart& hart);
 	void thread_func();
 };
@@ -0,0 +1,95 @@
+/*
+Copyright 2026 Spalishe
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#pragma once
+
+#include "../device.hpp"
+#include "../libfdt.hpp"
+#include "plic.hpp"
+#include "virtio_blk.hpp" // Common virtio-mmio registers and virtqueue layout
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#define VIRTIO_BALLOON_DEVICE_ID		  5
+
+// Config space
+#define VIRT_REG_BALLOON_NUMPAGES		  0x100 // Target balloon size in 4K pages, set by host
+#define VIRT_REG_BALLOON_ACTUAL			  0x104 // Current balloon size, set by guest
+
+#define VIRTIO_BALLOON_F_DEFLATE_ON_OOM	  (1ULL << 2)
+#define VIRTIO_BALLOON_F_REPORTING		  (1ULL << 5)
+
+// Queue order is fixed by negotiated features, we never offer stats or free page hint queues
+#define VIRTIO_BALLOON_Q_INFLATE		  0
+#define VIRTIO_BALLOON_Q_DEFLATE		  1
+#define VIRTIO_BALLOON_Q_REPORTING		  2
+#define VIRTIO_BALLOON_QUEUES			  3
+
+// Interrupt status bits
+#define VIRT_INTERRUPT_USED_BUFFER		  0x1
+#define VIRT_INTERRUPT_CONFIG_CHANGE	  0x2
+
+#define VIRTIO_BALLOON_PFN_SHIFT		  12
+
+struct VirtIO_Balloon : public Device
+{
+	VirtIO_Balloon(uint64_t base, uint64_t size, Machine& cpu, fdt_node* fdt);
+
+	uint64_t read(uint64_t addr, MemorySize size);
+	void write(uint64_t addr, MemorySize size, uint64_t val);
+	void tick();
+	static std::shared_ptr<VirtIO_Balloon> init_auto(Machine& cpu);
+
+	// Asks guest to grow or shrink balloon to this many 4K pages, safe to call from any thread
+	void set_target(uint32_t pages);
+	// Pages currently given away by guest
+	uint32_t get_actual()
+	{
+		return actual_pages;
+	}
+	// Bytes handed back to host by inflation and free page reporting so far
+	uint64_t reclaimed_bytes = 0;
+
+  private:
+	void process_queue(uint32_t qsel);
+	bool fetch_descriptor_chain(uint16_t head, std::vector<VirtqDesc>& out_chain, const VirtQueueState& q);
+	// Drops guest pages under array of 32-bit PFNs
+	void discard_pfns(const VirtqDesc& d);
+	void reset_queues();
+	void raise_irq();
+
+  private:
+	PLIC* plic;
+	uint8_t irq_num;
+
+	uint64_t device_features	 = 0;
+	uint64_t driver_features	 = 0;
+	uint32_t device_features_sel = 0;
+	uint32_t driver_features_sel = 0;
+	uint32_t device_status		 = 0;
+	uint32_t interrupt_status	 = 0;
+
+	uint32_t queue_sel = 0;
+	VirtQueueState queues[VIRTIO_BALLOON_QUEUES];
+
+	std::atomic<uint32_t> target_pages = 0;
+	std::atomic<bool> target_changed   = false;
+	uint32_t actual_pages			   = 0;
+	uint32_t config_generation		   = 0;
+};
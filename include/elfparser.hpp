@@ -76,7 +76,9 @@ struct ELFParser
 	MemoryMap* mmap;
 
 	bool parse(std::string file, uint64_t* entry_pc);
-	bool parse(char* buffer, size_t size, uint64_t* entry_pc);
+	bool parse(const char* buffer, size_t size, uint64_t* entry_pc);
+	// First byte after the highest loadable segment (BSS included), 0 if there is none
+	static uint64_t image_end(const char* buffer, size_t size);
 
 	template <typename T>
 	T read_from_buffer(const char* data, size_t* offset)
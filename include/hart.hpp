@@ -15,15 +15,20 @@ Copyright 2026 Spalishe
 
 */
 
+#include "blockcache.hpp"
 #include "decode.hpp"
 #include "defines/csr.hpp"
 #include "defines/traps.hpp"
 #include "memory_map.hpp"
 #include "mmio.hpp"
+#include "mmu.hpp"
 #include "rvjit/rvjit.hpp"
 #include "rvjit/rvjit_decode.hpp"
 #include "structs/timecmp_st.hpp"
+#include "utils/futex.hpp"
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 
 enum class PrivilegeMode
 {
@@ -40,6 +45,11 @@ struct InstructionCache;
 struct Reservation
 {
 	uint64_t vaddr;
+	// Value seen by LR, SC fails if memory does not hold it anymore
+	uint64_t value;
+	// Reserved DRAM location and its line version from MemoryMap::resv_table, nullptr for devices
+	uint8_t* host;
+	uint32_t version;
 	MemorySize size;
 	bool valid;
 };
@@ -48,6 +58,9 @@ struct Hart
 {
 	Hart(uint8_t id, uint64_t memsize) : id(id)
 	{
+		csrs   = new uint64_t[CSR_COUNT]();
+		bcache = new BlockCache();
+		dcache = new DecodeCache();
 #ifdef USE_JIT
 		jctx	  = new JIT_Context(memsize);
 		hctx	  = JIT_HartContext();
@@ -58,55 +71,182 @@ struct Hart
 	Hart& operator=(const Hart&) = delete;
 	~Hart()
 	{
+		delete[] csrs;
+		delete bcache;
+		delete dcache;
 #ifdef USE_JIT
 		delete jctx;
 #endif
 	};
 	Hart(Hart&& other) noexcept
 	{
+		csrs		 = other.csrs;
+		other.csrs	 = nullptr;
+		bcache		 = other.bcache;
+		other.bcache = nullptr;
+		dcache		 = other.dcache;
+		other.dcache = nullptr;
 #ifdef USE_JIT
 		jctx	   = other.jctx;
 		other.jctx = nullptr;
 #endif
+		take_state(other);
 	}
 
 	Hart& operator=(Hart&& other) noexcept
 	{
 		if(this != &other)
 		{
+			delete[] csrs;
+			csrs	   = other.csrs;
+			other.csrs = nullptr;
+			delete bcache;
+			bcache		 = other.bcache;
+			other.bcache = nullptr;
+			delete dcache;
+			dcache		 = other.dcache;
+			other.dcache = nullptr;
 #ifdef USE_JIT
 			delete jctx;
 			jctx	   = other.jctx;
 			other.jctx = nullptr;
 #endif
+			take_state(other);
 		}
 		return *this;
 	}
-	uint8_t id;
-	uint64_t GPR[32];
+	// Copies identity and architectural state, pointers back into hart are made to point here
+	void take_state(const Hart& other)
+	{
+		id = other.id;
+		memcpy(GPR, other.GPR, sizeof(GPR));
+		pc			 = other.pc;
+		mode		 = other.mode;
+		status		 = other.status;
+		ie			 = other.ie;
+		ip			 = other.ip;
+		seip_sw		 = other.seip_sw;
+		fcsr		 = other.fcsr;
+		WFI			 = other.WFI;
+		block_interp = other.block_interp;
+		retired		 = other.retired;
+		stalled		 = other.stalled;
+		mmap		 = other.mmap;
+		mmio		 = other.mmio;
+		idec		 = other.idec;
 #ifdef USE_FPU
-	double FPR[32];
+		memcpy(FPR, other.FPR, sizeof(FPR));
 #endif
-	uint64_t csrs[4096];
-	InstructionDecoder* idec;
+		mtime		  = other.mtime;
+		mcycle_base	  = other.mcycle_base;
+		minstret_base = other.minstret_base;
 #ifdef USE_JIT
-	JIT_Context* jctx;
-	JIT_InstructionDecoder* jidec;
-	JIT_HartContext hctx;
-	uint64_t last_jit_pc_exit = 0;
+		jit_enabled	  = other.jit_enabled;
+		jidec		  = other.jidec;
+		hctx		  = other.hctx;
+		hctx.hart	  = this;
+		hctx.regs	  = GPR;
 #endif
-	MemoryMap* mmap;
-	MMIO* mmio;
-
+	}
+	// Hot state comes first and starts on its own cache line: everything tick() and the
+	// interpreted instructions touch, so pc and flags sit right after GPR (JIT works on GPR too)
+	alignas(64) uint64_t GPR[32];
 	uint64_t pc;
 	PrivilegeMode mode;
-
 	status_t status;
 	ie_t ie;
 	ip_t ip;
-	timecmp_st stimecmp;
 	fcsr_t fcsr;
 	bool WFI = false;
+	// Set by trap(), ends current run() so scheduler can look at this hart
+	bool trap_taken = false;
+	// Deterministic SMP: device accesses and atomics fail with EXC_SYNC_DEFER while set, that ends run() with sync_pending
+	bool defer_shared = false;
+	bool sync_pending = false;
+	// Run pre-decoded blocks instead of single instructions where possible
+	bool block_interp = true;
+#ifdef USE_JIT
+	// Compiled blocks ignore quantum and defer_shared, so deterministic machine turns them off
+	bool jit_enabled = true;
+#endif
+	// Retired instructions and cycles that retired nothing (WFI, traps). Counter CSRs are computed from them only when read
+	uint64_t retired = 0;
+	uint64_t stalled = 0;
+	inline uint64_t cycles()
+	{
+		return retired + stalled;
+	}
+	MemoryMap* mmap;
+	MMIO* mmio;
+	const InstructionDecoder* idec;
+	DecodeCache* dcache;
+	BlockCache* bcache;
+	// Separately allocated, most of it is never touched
+	uint64_t* csrs;
+#ifdef USE_FPU
+	double FPR[32];
+#endif
+	// Fast TLB is the first member of MMU
+	MMU mmu;
+
+	// Cold state
+	uint8_t id;
+#ifdef USE_JIT
+	JIT_Context* jctx;
+	JIT_InstructionDecoder* jidec;
+	JIT_HartContext hctx;
+	uint64_t last_jit_pc_exit = 0;
+#endif
+	timecmp_st stimecmp;
+	// CLINT clock, time CSR is read straight from it
+	timer_st* mtime		   = nullptr;
+	uint64_t mcycle_base   = 0;
+	uint64_t minstret_base = 0;
+	// Cycles left from current quantum in deterministic SMP
+	uint64_t quantum_left = 0;
+
+	// Written by other threads, kept off the hot lines
+	// Asks run() to return at next block boundary, may be set from any thread
+	alignas(64) std::atomic<bool> exit_request = false;
+	// Interrupt lines driven by CLINT and PLIC from any thread. Hart copies their edges into ip itself at next tick
+	std::atomic<uint16_t> irq_lines = 0;
+	std::atomic<bool> irq_changed	= false;
+	uint16_t irq_seen				= 0;
+	// mip.SEIP as last written by software, the visible bit is this OR'd with the PLIC line
+	bool seip_sw = false;
+	// Sets lines in mask to level, wakes hart if some line rises
+	inline void drive_irq(uint16_t mask, uint16_t level)
+	{
+		uint16_t prev = irq_lines.load(std::memory_order_relaxed);
+		uint16_t next;
+		do
+		{
+			next = (prev & ~mask) | (level & mask);
+			if(next == prev) return;
+		} while(!irq_lines.compare_exchange_weak(prev, next, std::memory_order_release, std::memory_order_relaxed));
+		irq_changed.store(true, std::memory_order_release);
+		if(next & ~prev) ring();
+	}
+	void fold_irq();
+	void update_seip();
+	// Bumped whenever hart has to look at its interrupts again, hart thread parks on it while in WFI
+	std::atomic<uint32_t> doorbell = 0;
+	// Set while hart thread sleeps in park(), lets ring() skip the syscall otherwise
+	std::atomic<bool> parked = false;
+	// Wakes hart parked in WFI, called by whoever makes interrupt pending from another thread
+	inline void ring()
+	{
+		doorbell.fetch_add(1, std::memory_order_seq_cst);
+		if(parked.load(std::memory_order_seq_cst)) futex_wake(doorbell);
+	}
+	// Sleeps until doorbell moves on from bell or timeout_ns passes
+	inline void park(uint32_t bell, uint64_t timeout_ns = UINT64_MAX)
+	{
+		parked.store(true, std::memory_order_seq_cst);
+		if(doorbell.load(std::memory_order_seq_cst) == bell)
+			futex_wait(doorbell, bell, timeout_ns);
+		parked.store(false, std::memory_order_relaxed);
+	}
 
 	Reservation reservation;
 	inline void amo_check_reservation(uint64_t va)
@@ -119,11 +259,76 @@ struct Hart
 
 	void init(uint64_t dtb_pos_at_memory, uint64_t entry_pc);
 	uint64_t csr_read(uint16_t csr);
+	// Value csrrs/csrrc modify, mip uses software SEIP here instead of the OR'd one
+	uint64_t csr_read_rmw(uint16_t csr);
 	void csr_write(uint16_t csr, uint64_t val);
 	void trap(uint64_t cause, uint64_t tval, bool interrupt);
 	void tick();
+	uint64_t run(uint64_t budget);
 	ExecReturn single_inst(InstructionCache& cache);
-	uint32_t fetch(uint64_t inst_pc);
+	bool exec_block();
+	MemoryReturn fetch(uint64_t inst_pc, uint32_t* inst);
+	// Fetches and decodes instruction at inst_pc, decoded copy is reused until its page is written
+	MemoryReturn fetch_decoded(uint64_t inst_pc, InstructionCache** cache);
 	bool int_local_pending();
 	bool check_ints();
+
+	// Guest loads and stores, host pointer lookup first and MMIO on miss
+	template <typename T>
+	inline MemoryReturn load(uint64_t vaddr, T* val)
+	{
+		FastTLBEntry& e = mmu.ftlb[MMU::fast_index(vaddr)];
+		uint64_t off	= vaddr & (PAGE_SIZE - 1);
+		if(e.vpn == (vaddr >> PAGE_SHIFT) && (e.perm & FAST_TLB_R) && off <= PAGE_SIZE - sizeof(T)) [[likely]]
+		{
+			memcpy(val, e.host + off, sizeof(T));
+			return { true, 0, 0 };
+		}
+		MemoryReturn out = mmio->read(*this, vaddr, (MemorySize)sizeof(T), val);
+		if(out.is_success) fast_tlb_fill(vaddr, AccessType::Read);
+		return out;
+	}
+	template <typename T>
+	inline MemoryReturn store(uint64_t vaddr, T val)
+	{
+		FastTLBEntry& e = mmu.ftlb[MMU::fast_index(vaddr)];
+		uint64_t off	= vaddr & (PAGE_SIZE - 1);
+		if(e.vpn == (vaddr >> PAGE_SHIFT) && (e.perm & FAST_TLB_W) && off <= PAGE_SIZE - sizeof(T)) [[likely]]
+		{
+			amo_check_reservation(vaddr);
+			memcpy(e.host + off, &val, sizeof(T));
+			mmap->page_gen[e.ppn_idx].fetch_add(1, std::memory_order_relaxed);
+			if(mmap->dirty.enabled()) [[unlikely]]
+				mmap->dirty.mark(e.ppn_idx);
+			return { true, 0, 0 };
+		}
+		MemoryReturn out = mmio->write(*this, vaddr, (MemorySize)sizeof(T), val);
+		if(out.is_success) fast_tlb_fill(vaddr, AccessType::Write);
+		return out;
+	}
+	void fast_tlb_fill(uint64_t vaddr, AccessType type);
+	// Host pointer for atomic access to naturally aligned vaddr, *host is nullptr when it is not DRAM
+	MemoryReturn atomic_ptr(uint64_t vaddr, MemorySize size, AccessType type, uint8_t** host);
+#ifdef USE_JIT
+	// JIT blocks work with physical addresses only
+	inline bool jit_usable()
+	{
+		return jit_enabled && !mmu.enabled(*this, AccessType::Execute) && !mmu.enabled(*this, AccessType::Read);
+	}
+#endif
 };
+
+inline PrivilegeMode effective_mode(Hart& h, AccessType type)
+{
+	// MPRV makes loads and stores in M-mode behave like they were done in MPP mode
+	if(type != AccessType::Execute && h.mode == PrivilegeMode::Machine && h.status.fields.MPRV)
+		return (PrivilegeMode)h.status.fields.MPP;
+	return h.mode;
+}
+
+inline bool MMU::enabled(Hart& h, AccessType type)
+{
+	if(SATP_MODE(h.csrs[CSR_SATP]) == SATP_MODE_BARE) [[likely]]
+		return false;
+	return effective_mode(h, type) != PrivilegeMode::Machine;
+}
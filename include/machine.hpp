@@ -22,6 +22,8 @@ Copyright 2026 Spalishe
 #include "memory_map.hpp"
 #include "mmio.hpp"
 #include "rvjit/rvjit_decode.hpp"
+#include <barrier>
+#include <optional>
 #include <thread>
 #include <vector>
 
@@ -38,19 +40,29 @@ struct Machine
 	Machine(uint64_t mem_size, uint8_t hart_count);
 	~Machine()
 	{
-		state = MachineState::Off;
+		set_state(MachineState::Off);
 		destroy_harts();
 		destroy_devices();
 		destroy_mmap();
 		if(work_thread_w && !work_thread_joined) work_thread.join();
 		if(fdt)
 			fdt_node_free(fdt);
-		delete idec;
 #ifdef USE_JIT
 		delete jidec;
 #endif
 	}
 	uint64_t memory_size;
+	// Back DRAM with huge pages (must be set before init_mmap)
+	bool hugepages = false;
+	// Run pre-decoded basic blocks, interrupts are taken only between blocks
+	bool block_interp = true;
+	// Cycles hart runs before it looks at machine state again
+	uint64_t quantum = 0x1000;
+	// Harts run in lockstep quanta and meet at barrier, where devices, interrupts, atomics and device accesses
+	// are handled in fixed order. Runs are reproducible unless guest races on plain memory (must be set before init_auto_devices)
+	bool deterministic = false;
+	// Guest time of deterministic machine, one nanosecond per cycle
+	uint64_t virtual_ns = 0;
 	std::string append;
 	std::string dtb_dump_path;
 	// File, that will be used to automatically load as Block device.
@@ -61,12 +73,22 @@ struct Machine
 	FILE* kernel_file = nullptr;
 	// File, that will be automatically loaded as FDT
 	FILE* dtb_file	  = nullptr;
+	// File, that will be automatically loaded right below FDT and advertised in /chosen
+	FILE* initrd_file = nullptr;
+	// File that seeds DRAM, mapped copy-on-write so machines using same file share its pages (must be set before init_mmap).
+	// Memory only, not a snapshot: harts and devices start from reset. Bios, kernel, initrd and FDT are not loaded over it
+	FILE* ram_preload_file = nullptr;
+	// Adds VirtIO balloon device, so guest can hand its unused memory back to host
+	bool balloon	  = false;
+	// Memory in bytes guest is asked to give back through balloon when device comes up
+	uint64_t balloon_target = 0;
 	// Stream, where all output data from UART will come
 	FILE* uart_out	  = stdout;
 	fdt_node* fdt;
 	MemoryMap* mmap;
 	MMIO* mmio;
-	InstructionDecoder* idec;
+	// Shared with every other machine in process, never freed
+	const InstructionDecoder* idec;
 #ifdef USE_JIT
 	JIT_InstructionDecoder* jidec;
 #endif
@@ -74,6 +96,8 @@ struct Machine
 	uint64_t timebase = 5'000'000ULL;
 	uint8_t harts_count;
 	std::vector<Hart> harts;
+	// One per hart while they run in parallel, empty when work thread runs them itself
+	std::vector<std::thread> hart_threads;
 	std::thread work_thread;
 	bool work_thread_w = false;
 	bool work_thread_joined; // manual variable to indicate that thread was joined. You probably want to set it to true if you do work_thread.join();
@@ -81,8 +105,9 @@ struct Machine
 	std::atomic<MachineState> state = MachineState::Off;
 
 #ifdef USE_GDBSTUB
-	bool gdb			 = false;
-	bool gdb_single_step = false;
+	bool gdb = false;
+	// Work thread runs one instruction and halts machine again, set by step()
+	std::atomic<bool> gdb_single_step = false;
 #endif
 
 	void init_mmap();
@@ -94,11 +119,56 @@ struct Machine
 	void destroy_devices();
 	void destroy_mmap();
 	void reset_memory();
+	// Dirty page logging of DRAM, bits are read with mmap->dirty.collect(). Harts must not run while it is switched
+	void enable_dirty_log();
+	void disable_dirty_log();
+	bool use_blocks();
+	bool use_hart_threads();
 	void run();
 	void reset();
 	void work();
 	void stop();
+	// Stores new state and wakes everyone sleeping on previous one
+	void set_state(MachineState s);
+	// Running -> Halted, harts leave run() at next block boundary and sleep until resume(). Any thread may call these
+	bool pause();
+	bool resume();
+	// Asks guest to inflate or deflate balloon to this many bytes, false without balloon device. Any thread may call it
+	bool set_balloon_target(uint64_t bytes);
+#ifdef USE_GDBSTUB
+	// Runs one instruction of halted machine, returns once it is halted again
+	bool step();
+#endif
+	// Makes every hart leave run() at next block boundary
+	void request_exit();
 
   private:
-	uint16_t dev_tick_time;
+	uint64_t dev_tick_time = 0;
+
+	void start_harts();
+	// Harts have to be told to leave first (state switched and request_exit)
+	void join_harts();
+	void hart_work(Hart& h);
+	bool on_machine_thread();
+
+	// Deterministic SMP, serial phase runs on last hart to reach the barrier
+	struct LockstepSync
+	{
+		Machine* machine;
+		void operator()() noexcept
+		{
+			machine->serial_phase();
+		}
+	};
+	std::optional<std::barrier<LockstepSync>> lockstep;
+	bool lockstep_exit = false;
+	void hart_work_lockstep(Hart& h);
+	void serial_phase();
+
+	// Loads bios, kernel and initrd into memory
+	bool load_images(uint64_t* entry = nullptr);
+	// First byte after bios and kernel in memory, ELF images count with their BSS
+	uint64_t images_end();
+	// Returns where initrd is placed in memory, false if there is none or it would overlap bios or kernel
+	bool initrd_range(uint64_t* start, uint64_t* end);
 };
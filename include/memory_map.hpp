@@ -17,30 +17,82 @@ Copyright 2026 Spalishe
 
 #pragma once
 #include "elfparser.hpp"
+#include "utils/dirty_bitmap.hpp"
+#include "utils/mapped_file.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <format>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <new>
 #include <optional>
 #include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#define HUGE_2M		  (2ULL << 20)
+#define HUGE_1G		  (1ULL << 30)
+
+// Host window mirroring guest physical space below 4G, DRAM sits at window + paddr and the rest is PROT_NONE
+#define FASTMEM_SIZE  (1ULL << 32)
+#define FASTMEM_GUARD (1ULL << 16) // Catches widest access that starts right below 4G
+
+// What actually backs region's memory
+enum class HugePages
+{
+	None,
+	Transparent, // madvise(MADV_HUGEPAGE), kernel decides
+	Huge2M,		 // MAP_HUGETLB with 2M pages
+	Huge1G		 // MAP_HUGETLB with 1G pages
+};
+
 struct MemoryRegion
 {
 	uint64_t base_addr;
 	size_t size;
 	uint8_t* data;
+	HugePages huge = HugePages::None;
 
-	MemoryRegion(uint64_t base, size_t sz)
-		: base_addr(base), size(sz)
+	// at: place region at this host address inside already reserved range
+	// image_fd: file or memfd with initial contents, shared copy-on-write with everyone mapping it
+	MemoryRegion(uint64_t base, size_t sz, bool hugepages = false, uint8_t* at = nullptr, int image_fd = -1)
+		: base_addr(base), size(sz), map_size(sz), at(at)
 	{
-		data = new uint8_t[size]{ 0 };
+		if(hugepages && image_fd < 0)
+		{
+			map_huge();
+			return;
+		}
+		// Anonymous mapping is zero-filled and pages are committed only on first touch
+		void* p = map(size, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE);
+		if(p == MAP_FAILED)
+			throw std::bad_alloc();
+		data = (uint8_t*)p;
+		if(image_fd >= 0)
+			map_image(image_fd);
 	}
 
 	~MemoryRegion()
 	{
-		delete[] data;
+		if(at != nullptr)
+			guard(data, map_size); // Range stays reserved, hand it back as guard
+		else
+			::munmap(data, map_size);
+	}
+
+	// Zeroes region by dropping its pages, they will be faulted in again as zero pages (or image pages)
+	void reset()
+	{
+		if(madvise(data, size, MADV_DONTNEED) != 0)
+			memset(data, 0, size);
 	}
 
 	uint8_t* ptr(uint64_t addr)
@@ -55,73 +107,249 @@ struct MemoryRegion
 			return std::nullopt;
 		return data + (addr - base_addr);
 	}
+
+	// Turns host range into inaccessible reservation
+	static void guard(void* addr, size_t len)
+	{
+		::mmap(addr, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+	}
+
+  private:
+	size_t map_size; // Size of host mapping, may be rounded up to huge page size
+	uint8_t* at;
+
+	void* map(size_t len, int flags)
+	{
+		if(at == nullptr)
+			return ::mmap(nullptr, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+		void* p = ::mmap(at, len, PROT_READ | PROT_WRITE, flags | MAP_FIXED, -1, 0);
+		if(p == MAP_FAILED)
+			guard(at, len); // Failed fixed mapping may leave hole in reservation
+		return p;
+	}
+
+	// Private file mapping over the start of region, page is copied only when guest writes it
+	void map_image(int fd)
+	{
+		struct stat st;
+		if(fstat(fd, &st) != 0)
+			throw std::runtime_error("RAM image is not accessible");
+		// Tail of the last page past EOF reads as zeroes, whole pages past it would be SIGBUS
+		size_t len = std::min<size_t>((st.st_size + 4095) & ~4095ULL, size);
+		if(len == 0) return;
+		void* p = ::mmap(data, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+		if(p == MAP_FAILED)
+			throw std::runtime_error(std::string("RAM image mapping failed: ") + std::strerror(errno));
+	}
+
+	void map_huge()
+	{
+		// No MAP_NORESERVE here: pool must be reserved up front, otherwise touching page would end in SIGBUS
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+
+		// Explicit huge pages from the hugetlb pool, biggest first
+		if(size % HUGE_1G == 0)
+		{
+			void* p = map(size, flags | (30 << MAP_HUGE_SHIFT));
+			if(p != MAP_FAILED)
+			{
+				data = (uint8_t*)p;
+				huge = HugePages::Huge1G;
+				return;
+			}
+		}
+		map_size = (size + HUGE_2M - 1) & ~(HUGE_2M - 1);
+		void* p	 = map(map_size, flags | (21 << MAP_HUGE_SHIFT));
+		if(p != MAP_FAILED)
+		{
+			data = (uint8_t*)p;
+			huge = HugePages::Huge2M;
+			return;
+		}
+
+		// Transparent huge pages, they need 2M aligned range so map more and trim it
+		size_t aligned = (size + HUGE_2M - 1) & ~(HUGE_2M - 1);
+		if(at != nullptr)
+		{
+			// Reservation is already aligned
+			p = map(aligned, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE);
+			if(p == MAP_FAILED)
+				throw std::bad_alloc();
+			data	 = (uint8_t*)p;
+			map_size = aligned;
+			huge	 = madvise(data, map_size, MADV_HUGEPAGE) == 0 ? HugePages::Transparent : HugePages::None;
+			return;
+		}
+		p = ::mmap(nullptr, aligned + HUGE_2M, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if(p == MAP_FAILED)
+			throw std::bad_alloc();
+		uintptr_t start = ((uintptr_t)p + HUGE_2M - 1) & ~(HUGE_2M - 1);
+		if(start != (uintptr_t)p)
+			::munmap(p, start - (uintptr_t)p);
+		size_t tail = ((uintptr_t)p + aligned + HUGE_2M) - (start + aligned);
+		if(tail != 0)
+			::munmap((void*)(start + aligned), tail);
+		data	 = (uint8_t*)start;
+		map_size = aligned;
+		huge	 = madvise(data, map_size, MADV_HUGEPAGE) == 0 ? HugePages::Transparent : HugePages::None;
+	}
 };
 
 struct MemoryMap
 {
 	std::vector<MemoryRegion*> regions;
 	MemoryRegion* ram_direct = nullptr;
-	ELFParser elf			 = ELFParser(this);
+	// Guest physical address X lives at fastmem + X, nullptr if DRAM is outside of the window
+	uint8_t* fastmem = nullptr;
+	// Pages of DRAM written since last collect, tracked only while enabled
+	DirtyBitmap dirty;
+	// Write generation of every DRAM page, code decoded from page is valid while its generation is unchanged.
+	// Harts bump and read it from their own threads, relaxed is enough as guest orders code writes with FENCE.I and IPIs
+	std::atomic<uint32_t>* page_gen = nullptr;
+	// Serialises AMOs and LR/SC that hit devices instead of DRAM
+	std::mutex amo_lock;
+	// Version of every 64 byte DRAM line (hashed by host address), bumped by AMOs and successful SCs.
+	// LR remembers it, so SC of another hart breaks reservation even if value was written back unchanged
+	static constexpr size_t RESV_TABLE_SIZE = 4096;
+	std::atomic<uint32_t> resv_table[RESV_TABLE_SIZE]{};
+	static inline size_t resv_index(const uint8_t* host)
+	{
+		return ((uintptr_t)host >> 6) & (RESV_TABLE_SIZE - 1);
+	}
+	ELFParser elf = ELFParser(this);
 	// std::unordered_map<uint64_t,MemoryRegion*> cache;
 
 	~MemoryMap()
 	{
 		for(auto* r : regions)
 			delete r;
+		delete[] page_gen;
+		if(fastmem)
+			::munmap(fastmem, FASTMEM_SIZE + FASTMEM_GUARD);
 	}
 
-	void add_region(uint64_t base, size_t size)
+	// image_fd: DRAM starts as copy-on-write view of this file, see MemoryRegion
+	void add_region(uint64_t base, size_t size, bool hugepages = false, int image_fd = -1)
 	{
-		regions.push_back(new MemoryRegion(base, size));
 		if(base >= 0x80000000)
 		{
+			// DRAM goes into the window when it fits there
+			uint8_t* at = nullptr;
+			if(ram_direct == nullptr && base + size <= FASTMEM_SIZE && reserve_fastmem())
+				at = fastmem + base;
+			regions.push_back(new MemoryRegion(base, size, hugepages, at, image_fd));
 			ram_direct = regions.back();
+			page_gen   = new std::atomic<uint32_t>[(size + 4095) >> 12]{};
+			return;
 		}
+		regions.push_back(new MemoryRegion(base, size, hugepages));
 	}
 
-	bool load_file(uint64_t memory_path, std::string path = "", uint64_t* entry_pc = NULL)
+	void enable_dirty_log()
 	{
-		std::ifstream file(path, std::ios::binary | std::ios::ate);
-		if(!file.is_open())
-		{
-			// error
-			std::cout << "[RISCV-EM] File loading error! " << std::strerror(errno) << std::endl;
-			return false;
-		}
+		if(ram_direct) dirty.enable((ram_direct->size + 4095) >> 12);
+	}
+	void disable_dirty_log()
+	{
+		dirty.disable();
+	}
+	// Records write to every DRAM page touched by this range: bumps its generation and marks it in dirty bitmap.
+	// Anything outside of DRAM is ignored
+	inline void mark_dirty(uint64_t addr, uint64_t len)
+	{
+		uint64_t off = addr - ram_direct->base_addr;
+		if(off >= ram_direct->size || len == 0) return;
+		uint64_t first = off >> 12;
+		uint64_t last  = std::min<uint64_t>(off + len - 1, ram_direct->size - 1) >> 12;
+		for(uint64_t page = first; page <= last; page++)
+			page_gen[page].fetch_add(1, std::memory_order_relaxed);
+		if(dirty.enabled()) [[unlikely]]
+			dirty.mark_range(first, last);
+	}
 
-		std::streamsize size = file.tellg();
-		file.seekg(0, std::ios::beg);
-		std::vector<char> buffer(size);
-		file.read(buffer.data(), size);
+	// Same as above for single write through host pointer into DRAM
+	inline void mark_dirty_host(const uint8_t* host)
+	{
+		uint64_t page = (host - ram_direct->data) >> 12;
+		page_gen[page].fetch_add(1, std::memory_order_relaxed);
+		if(dirty.enabled()) [[unlikely]]
+			dirty.mark(page);
+	}
 
-		bool isElf = *(uint32_t*)buffer.data() == ELF_MAGIC;
+	// Gives DRAM pages fully inside the range back to host, they read as zero (or image contents) afterwards.
+	// Returns count of dropped bytes
+	uint64_t discard(uint64_t addr, uint64_t len)
+	{
+		if(!ram_direct || len == 0) return 0;
+		uint64_t ram_start = ram_direct->base_addr;
+		uint64_t ram_end   = ram_start + ram_direct->size;
+		uint64_t first	   = std::max(addr, ram_start);
+		uint64_t last	   = addr + len < addr ? ram_end : std::min(addr + len, ram_end);
+		first			   = (first + 4095) & ~4095ULL;
+		last &= ~4095ULL;
+		if(first >= last) return 0;
+		if(madvise(ram_direct->data + (first - ram_start), last - first, MADV_DONTNEED) != 0)
+			return 0;
+		mark_dirty(first, last - first);
+		return last - first;
+	}
 
-		if(isElf)
+	// Copies DRAM into new memfd, it can be passed as image to other machines. Returns -1 on failure
+	int export_ram()
+	{
+		if(!ram_direct) return -1;
+		int fd = memfd_create("riscv-em-ram", MFD_CLOEXEC);
+		if(fd < 0) return -1;
+		if(ftruncate(fd, ram_direct->size) != 0)
 		{
-			return elf.parse(path, entry_pc);
+			close(fd);
+			return -1;
 		}
-		else
+		// Zero pages are skipped, they stay holes in the file
+		static const uint8_t zero[4096] = {};
+		for(uint64_t off = 0; off < ram_direct->size; off += 4096)
 		{
-			// binary
-			auto region	 = find_region(memory_path);
-			uint8_t* ptr = region->ptr(memory_path);
-			memcpy(ptr, buffer.data(), size);
-			return true;
+			size_t len = std::min<uint64_t>(4096, ram_direct->size - off);
+			if(memcmp(ram_direct->data + off, zero, len) == 0) continue;
+			if(pwrite(fd, ram_direct->data + off, len, off) != (ssize_t)len)
+			{
+				close(fd);
+				return -1;
+			}
 		}
+		return fd;
 	}
 
-	bool load_buffer(uint64_t memory_path, char* buffer, uint64_t size, uint64_t* entry_pc = NULL)
+	bool load_file(uint64_t memory_path, std::string path = "", uint64_t* entry_pc = NULL)
 	{
-		bool isElf = *(uint32_t*)buffer == ELF_MAGIC;
+		MappedFile file(path);
+		if(!file.valid())
+		{
+			// error
+			std::cout << "[RISCV-EM] File loading error! " << std::strerror(errno) << std::endl;
+			return false;
+		}
+		return load_buffer(memory_path, file.data, file.size, entry_pc);
+	}
+
+	bool load_buffer(uint64_t memory_path, const char* buffer, uint64_t size, uint64_t* entry_pc = NULL)
+	{
+		bool isElf = size >= sizeof(uint32_t) && *(const uint32_t*)buffer == ELF_MAGIC;
 		if(isElf)
 		{
 			return elf.parse(buffer, size, entry_pc);
 		}
 		else
 		{
-			auto region	 = find_region(memory_path);
+			auto region = find_region(memory_path);
+			if(memory_path + size > region->base_addr + region->size)
+			{
+				std::cout << "[RISCV-EM] File does not fit into memory!" << std::endl;
+				return false;
+			}
 			uint8_t* ptr = region->ptr(memory_path);
 			memcpy(ptr, buffer, size);
+			mark_dirty(memory_path, size);
 			return true;
 		}
 	}
@@ -130,22 +358,16 @@ struct MemoryMap
 	{
 		MemoryRegion* r = find_region(addr);
 		uint8_t* p		= r->ptr(addr);
+		uint64_t val	= 0;
 		switch(size)
 		{
 			case 8:
-				return p[0];
 			case 16:
-				return p[0] | ((uint64_t)p[1] << 8);
 			case 32:
-				return p[0] | ((uint64_t)p[1] << 8)
-					   | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24);
 			case 64:
-			{
-				uint64_t val = 0;
-				for(int i = 0; i < 8; i++)
-					val |= ((uint64_t)p[i] << (i * 8));
+				// Guest and host are both little-endian
+				memcpy(&val, p, size / 8);
 				return val;
-			}
 			default:
 				throw std::invalid_argument("Invalid load size");
 		}
@@ -206,27 +428,34 @@ struct MemoryMap
 		switch(size)
 		{
 			case 8:
-				p[0] = (uint8_t)value;
-				break;
 			case 16:
-				p[0] = (uint8_t)value;
-				p[1] = (uint8_t)(value >> 8);
-				break;
 			case 32:
-				p[0] = (uint8_t)value;
-				p[1] = (uint8_t)(value >> 8);
-				p[2] = (uint8_t)(value >> 16);
-				p[3] = (uint8_t)(value >> 24);
-				break;
 			case 64:
-				for(int i = 0; i < 8; i++)
-					p[i] = (uint8_t)(value >> (i * 8));
+				memcpy(p, &value, size / 8);
+				mark_dirty(addr, size / 8);
 				break;
 			default:
 				throw std::invalid_argument("Invalid store size");
 		}
 	}
 
+	// Reserves window without committing anything, aligned to 1G so huge pages can be placed in it
+	bool reserve_fastmem()
+	{
+		size_t len = FASTMEM_SIZE + FASTMEM_GUARD;
+		void* p	   = ::mmap(nullptr, len + HUGE_1G, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if(p == MAP_FAILED)
+			return false;
+		uintptr_t start = ((uintptr_t)p + HUGE_1G - 1) & ~(HUGE_1G - 1);
+		if(start != (uintptr_t)p)
+			::munmap(p, start - (uintptr_t)p);
+		size_t tail = ((uintptr_t)p + len + HUGE_1G) - (start + len);
+		if(tail != 0)
+			::munmap((void*)(start + len), tail);
+		fastmem = (uint8_t*)start;
+		return true;
+	}
+
 	MemoryRegion* find_region(uint64_t addr)
 	{
 		// if(cache.find(addr) != cache.end()) {return cache[addr];}
@@ -27,9 +27,19 @@ Copyright 2026 Spalishe
 struct Hart;
 struct Machine;
 
+// Device dispatch table: two levels, 2M chunks of 4K pages, covers everything below DRAM
+#define MMIO_PAGE_SHIFT	 12
+#define MMIO_L1_SHIFT	 21
+#define MMIO_L2_SIZE	 (1 << (MMIO_L1_SHIFT - MMIO_PAGE_SHIFT))
+#define MMIO_TABLE_LIMIT 0x80000000ULL
+#define MMIO_L1_SIZE	 (MMIO_TABLE_LIMIT >> MMIO_L1_SHIFT)
+// Page is shared by several devices, they are looked up linearly
+#define MMIO_SHARED_PAGE ((Device*)1)
+
 struct MMIO
 {
 	MMIO(MemoryMap* mmap, uint64_t mem_size);
+	~MMIO();
 
 	uint64_t memsize;
 	std::vector<std::shared_ptr<Device>> devs;
@@ -38,6 +48,9 @@ struct MMIO
 	MemoryReturn write(Hart& h, uint64_t vaddr, MemorySize size, uint64_t val);
 	// Preforms read, returns whether read operation was successful
 	MemoryReturn read(Hart& h, uint64_t vaddr, MemorySize size, void* val);
+	// Same as above, but address is physical and never goes through hart's MMU
+	MemoryReturn write_phys(Hart& h, uint64_t paddr, MemorySize size, uint64_t val);
+	MemoryReturn read_phys(Hart& h, uint64_t paddr, MemorySize size, void* val);
 
 	// Creates new device
 	template <typename T, typename... Args>
@@ -45,6 +58,7 @@ struct MMIO
 	{
 		auto new_device = std::make_shared<T>(std::forward<Args>(args)...);
 		devs.push_back(new_device);
+		map_device(new_device.get());
 		return new_device;
 	}
 	// Creates new device calling it auto function
@@ -53,9 +67,36 @@ struct MMIO
 	{
 		auto new_device = T::init_auto(cpu);
 		devs.push_back(new_device);
+		map_device(new_device.get());
 		return new_device;
 	}
 
+	// Removes all devices
+	void clear_devices();
+
+	// Returns device that fully contains this access, or nullptr
+	inline Device* find_device(uint64_t paddr, MemorySize size)
+	{
+		if(paddr < MMIO_TABLE_LIMIT) [[likely]]
+		{
+			Device** l2 = dispatch[paddr >> MMIO_L1_SHIFT];
+			if(!l2) return nullptr;
+			Device* dev = l2[(paddr >> MMIO_PAGE_SHIFT) & (MMIO_L2_SIZE - 1)];
+			if(dev != MMIO_SHARED_PAGE)
+			{
+				if(dev && paddr >= dev->start && paddr + (uint64_t)size <= dev->end) [[likely]]
+					return dev;
+				return nullptr;
+			}
+		}
+		for(const auto& dev : devs)
+		{
+			if(paddr >= dev->start && paddr + (uint64_t)size <= dev->end)
+				return dev.get();
+		}
+		return nullptr;
+	}
+
 	// Runs tick() on every created device
 	void tick_all()
 	{
@@ -63,6 +104,7 @@ struct MMIO
 		{
 			if(dev)
 			{
+				std::lock_guard<std::mutex> guard(dev->lock);
 				dev->tick();
 			}
 		}
@@ -84,5 +126,7 @@ struct MMIO
 
   private:
 	MemoryMap* mmap;
+	Device** dispatch[MMIO_L1_SIZE]{};
+	void map_device(Device* dev);
 	inline uint64_t read_dram_fast(uint64_t vaddr, MemorySize size);
 };
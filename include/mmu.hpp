@@ -0,0 +1,115 @@
+/*
+Copyright 2026 Spalishe
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#pragma once
+#include "defines/traps.hpp"
+#include <cstdint>
+
+struct Hart;
+
+// satp.MODE values
+#define SATP_MODE_BARE 0
+#define SATP_MODE_SV39 8
+#define SATP_MODE_SV48 9
+
+#define SATP_PPN_MASK  0xFFFFFFFFFFFULL
+#define SATP_ASID(x)   (((x) >> 44) & 0xFFFF)
+#define SATP_MODE(x)   ((x) >> 60)
+
+// PTE flag bits
+#define PTE_V		   (1 << 0)
+#define PTE_R		   (1 << 1)
+#define PTE_W		   (1 << 2)
+#define PTE_X		   (1 << 3)
+#define PTE_U		   (1 << 4)
+#define PTE_G		   (1 << 5)
+#define PTE_A		   (1 << 6)
+#define PTE_D		   (1 << 7)
+
+#define PTE_PPN_SHIFT  10
+#define PTE_PPN_MASK   0xFFFFFFFFFFFULL
+#define PTE_RESERVED   0xFFC0000000000000ULL // Reserved, PBMT and N bits, all must be zero
+
+#define PAGE_SHIFT	   12
+#define PAGE_SIZE	   (1ULL << PAGE_SHIFT)
+
+#define TLB_SIZE	   256 // Must be power of 2
+#define FAST_TLB_SIZE  256 // Must be power of 2
+
+// Fast TLB permission bits
+#define FAST_TLB_R	   (1 << 0)
+#define FAST_TLB_W	   (1 << 1)
+
+enum class AccessType
+{
+	Read,
+	Write,
+	Execute
+};
+
+struct TLBEntry
+{
+	uint64_t vpn;	// Virtual page number of the 4K page
+	uint64_t ppn;	// Physical page number of the 4K page
+	uint16_t asid;
+	uint8_t flags;	// PTE flags of the leaf
+	uint8_t level;	// 0 = 4K, 1 = 2M, 2 = 1G, 3 = 512G
+	bool global;
+	bool valid;
+};
+
+// Guest page straight to host memory, only DRAM pages get here
+struct FastTLBEntry
+{
+	uint64_t vpn	 = ~0ULL;
+	uint8_t* host	 = nullptr; // Host pointer to the start of the page
+	uint64_t ppn_idx = 0;		// Page index from start of DRAM
+	uint8_t perm	 = 0;
+};
+
+// Per-hart software TLB, direct-mapped and tagged by ASID
+struct MMU
+{
+	// Valid only for current translation context, flushed on every change of it. Goes first, it is what loads and stores hit
+	FastTLBEntry ftlb[FAST_TLB_SIZE]{};
+	TLBEntry tlb[TLB_SIZE]{};
+
+	// Translates virtual address to physical one, returns page fault on failure
+	MemoryReturn translate(Hart& h, uint64_t vaddr, AccessType type, uint64_t* paddr);
+	// Returns whether access of this type goes through translation
+	bool enabled(Hart& h, AccessType type);
+
+	// SFENCE.VMA semantics
+	void flush_all();
+	void flush_asid(uint16_t asid);
+	void flush_vaddr(uint64_t vaddr);
+	void flush_vaddr_asid(uint64_t vaddr, uint16_t asid);
+	void flush_fast();
+
+	static inline uint64_t fast_index(uint64_t vaddr)
+	{
+		return (vaddr >> PAGE_SHIFT) & (FAST_TLB_SIZE - 1);
+	}
+
+  private:
+	static inline uint64_t tlb_index(uint64_t vpn)
+	{
+		return vpn & (TLB_SIZE - 1);
+	}
+	MemoryReturn walk(Hart& h, uint64_t vaddr, AccessType type, TLBEntry& out);
+	bool check_perm(Hart& h, uint8_t flags, AccessType type);
+};
@@ -22,6 +22,7 @@ Copyright 2026 Spalishe
 #include <cstring>
 #include <sys/mman.h>
 #include <unordered_map>
+#include <vector>
 
 #define RVJIT_MIN_INSTRUCTIONS 1
 #define RVJIT_MAX_INSTRUCTIONS 48
@@ -40,10 +41,20 @@ struct JIT_HartContext
 	uint64_t exit_pc = 0;
 	Hart* hart;
 	int32_t loop_count = 1000;
+	void* dirty		   = nullptr; // DRAM dirty bitmap while logging is on
+	uint32_t* page_gen  = nullptr; // MemoryMap::page_gen, stores bump it with LOCK INC like interpreter does
 };
 
 using JITCompilatedFunc = void (*)(JIT_HartContext*);
 
+struct JIT_Arena;
+// Fastmem access in compiled code that may fault and slow path it continues at, both are host addresses
+struct JIT_Fixup
+{
+	uint64_t access;
+	uint64_t slow;
+};
+
 struct JIT_Function
 {
 	JITCompilatedFunc func = nullptr;
@@ -51,8 +62,10 @@ struct JIT_Function
 	uint32_t size		   = 0; // emitted code size
 	uint64_t pc			   = 0;
 	uint16_t inst_size	   = 0;
+	uint32_t inst_count	   = 0; // guest instructions in one pass
 	bool valid			   = false;
 	uint64_t page_version  = 0; // at which page version this function was created
+	JIT_Arena* arena	   = nullptr;
 
 	JIT_Function(const JIT_Function&)			 = delete;
 	JIT_Function& operator=(const JIT_Function&) = delete;
@@ -63,33 +76,43 @@ struct JIT_Function
 		  size(other.size),
 		  pc(other.pc),
 		  inst_size(other.inst_size),
-		  valid(other.valid)
+		  inst_count(other.inst_count),
+		  valid(other.valid),
+		  page_version(other.page_version),
+		  arena(other.arena)
 	{
-		other.func		= nullptr;
-		other.offset	= 0;
-		other.size		= 0;
-		other.pc		= 0;
-		other.inst_size = 0;
-		other.valid		= false;
+		other.func		 = nullptr;
+		other.offset	 = 0;
+		other.size		 = 0;
+		other.pc		 = 0;
+		other.inst_size	 = 0;
+		other.inst_count = 0;
+		other.valid		 = false;
+		other.arena		 = nullptr;
 	}
 
 	JIT_Function& operator=(JIT_Function&& other) noexcept
 	{
 		if(this != &other)
 		{
-			func	  = other.func;
-			offset	  = other.offset;
-			size	  = other.size;
-			pc		  = other.pc;
-			inst_size = other.inst_size;
-			valid	  = other.valid;
-
-			other.func		= nullptr;
-			other.offset	= 0;
-			other.size		= 0;
-			other.pc		= 0;
-			other.inst_size = 0;
-			other.valid		= false;
+			func		 = other.func;
+			offset		 = other.offset;
+			size		 = other.size;
+			pc			 = other.pc;
+			inst_size	 = other.inst_size;
+			inst_count	 = other.inst_count;
+			valid		 = other.valid;
+			page_version = other.page_version;
+			arena		 = other.arena;
+
+			other.func		 = nullptr;
+			other.offset	 = 0;
+			other.size		 = 0;
+			other.pc		 = 0;
+			other.inst_size	 = 0;
+			other.inst_count = 0;
+			other.valid		 = false;
+			other.arena		 = nullptr;
 		}
 		return *this;
 	}
@@ -121,6 +144,7 @@ struct JIT_Arena
 		  base(other.base),
 		  size(other.size),
 		  used_size(other.used_size),
+		  fixups(std::move(other.fixups)),
 		  _page_size(other._page_size)
 	{
 		other.base		 = nullptr;
@@ -142,6 +166,7 @@ struct JIT_Arena
 			size	   = other.size;
 			valid	   = other.valid;
 			used_size  = other.used_size;
+			fixups	   = std::move(other.fixups);
 			_page_size = other._page_size;
 
 			// Reset other
@@ -157,8 +182,14 @@ struct JIT_Arena
 	void* base		   = nullptr;
 	uint64_t size	   = 0;
 	uint64_t used_size = 0;
+	// Sorted by access, functions are placed one after another and so are their accesses
+	std::vector<JIT_Fixup> fixups;
 
 	JIT_Function push_function(const void* code, size_t code_size);
+	// Slow path of faulting access at host address, 0 if there is none. Only reads, so fault handler may call it
+	uint64_t find_fixup(uint64_t access) const;
+	// Forgets fixups of code in [start, end)
+	void drop_fixups(uint64_t start, uint64_t end);
 	void init()
 	{
 		allocate();
@@ -188,6 +219,12 @@ struct HitPage
 		ignore[idx >> 6] |= 1ull << (idx & 63);
 	}
 };
+// Installs SIGSEGV handler that sends faulting fastmem accesses to their slow paths
+bool rvjit_fastmem_init();
+
+// Arena whose compiled code runs on this thread right now
+extern thread_local const JIT_Arena* jit_running;
+
 struct JIT_Context
 {
 	JIT_Context(uint64_t memory_size) : memory_size(memory_size)
@@ -195,16 +232,14 @@ struct JIT_Context
 		last_arena		   = 0;
 		emitter			   = JIT_Emitter();
 		jits			   = new JIT_Function[JIT_CACHE_SIZE];
-		page_verion_bitmap = new uint64_t[memory_size >> 12]{};
 		pc_hits.resize(memory_size >> 12, nullptr);
 		createNewArena();
+		fastmem = rvjit_fastmem_init();
 	};
 	~JIT_Context()
 	{
 		if(jits)
 			delete[] jits;
-		if(page_verion_bitmap)
-			delete[] page_verion_bitmap;
 		for(auto ptr : pc_hits)
 		{
 			if(ptr) delete ptr;
@@ -219,7 +254,8 @@ struct JIT_Context
 	JIT_Context(JIT_Context&& other) noexcept
 		: last_arena(other.last_arena), jits(std::move(other.jits)),
 		  arenas(std::move(other.arenas)),
-		  block_c(other.block_c), block(other.block), pc_hits(std::move(other.pc_hits))
+		  block_c(other.block_c), block(other.block), pc_hits(std::move(other.pc_hits)),
+		  fastmem(other.fastmem)
 	{
 		// Copy pc_hits
 		// memcpy(pc_hits, other.pc_hits, sizeof(pc_hits));
@@ -235,6 +271,7 @@ struct JIT_Context
 			// memcpy(&ignore_pc, &other.ignore_pc, sizeof(ignore_pc));
 
 			pc_hits	   = std::move(other.pc_hits);
+			fastmem	   = other.fastmem;
 			block_c	   = other.block_c;
 			block	   = other.block;
 			last_arena = other.last_arena;
@@ -248,11 +285,10 @@ struct JIT_Context
 	JIT_Function* jits;
 	std::unordered_map<uint64_t, JIT_Arena> arenas;
 	std::vector<HitPage*> pc_hits;
+	bool fastmem	= false; // Faults in fastmem window can be recovered
 	bool block_c	= false;
 	JIT_Block block = { 0 };
 
-	uint64_t* page_verion_bitmap;
-
 	uint64_t last_arena	 = 0;
 	uint64_t count		 = 0;
 	uint64_t memory_size = 0;
@@ -260,7 +296,14 @@ struct JIT_Context
 	JIT_Emitter emitter;
 
 	void handleInstruction(Hart& h, InstructionCache& cache, uint64_t prev_pc);
+	// Counts pass of pre-decoded block starting at pc. True while code there is too cold for profiling,
+	// after that single step path takes over so handleInstruction can compile it
+	bool block_cold(uint64_t pc);
 	void stopBlock();
+	// Drops single compiled block together with its fastmem fixups
+	void invalidate(JIT_Function& func);
+	// Drops every compiled block, they will be compiled again
+	void flush();
 	void createNewArena();
 
 	inline void clear_pc_hits()
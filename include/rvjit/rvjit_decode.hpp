@@ -43,5 +43,6 @@ struct JIT_InstructionDecoder
 	// This function will call on init, calling all sets functions to initialize
 	void init_all_instrs();
 	void init_rv64i();
+	void init_rv64m();
 };
 #endif
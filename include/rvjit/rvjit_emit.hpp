@@ -62,6 +62,8 @@ struct JIT_Block
 	uint16_t byte_pos = 0;
 	std::vector<JumpLabel> jmp_labels;
 	uint64_t inst_addr_jmp[RVJIT_FUNC_SIZE * 4];
+	// Guest memory access that may fault in fastmem window -> its slow path, both are offsets
+	std::vector<std::pair<uint16_t, uint16_t>> fastmem_fixups;
 
 	uint64_t pc;
 	uint64_t size  = 0;
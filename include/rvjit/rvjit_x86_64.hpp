@@ -320,6 +320,99 @@ inline void and_rimm32(JIT_Block& blk, char dest, int32_t imm32)
 	blk.bytes[blk.byte_pos++] = (imm32 >> 16) & 0xFF;
 	blk.bytes[blk.byte_pos++] = (imm32 >> 24) & 0xFF;
 }
+// IMUL r64, r/m64
+inline void imul_rr(JIT_Block& blk, char dest, char source)
+{
+	// dest is REG, source is RM
+	blk.bytes[blk.byte_pos++] = rex(1, (dest > 7), 0, (source > 7));
+	blk.bytes[blk.byte_pos++] = 0x0F;
+	blk.bytes[blk.byte_pos++] = 0xAF;
+	blk.bytes[blk.byte_pos++] = modrm(3, (dest & 7), (source & 7));
+}
+// IMUL r32, r/m32
+inline void imul_rr32(JIT_Block& blk, char dest, char source)
+{
+	// dest is REG, source is RM
+	blk.bytes[blk.byte_pos++] = rex(0, (dest > 7), 0, (source > 7));
+	blk.bytes[blk.byte_pos++] = 0x0F;
+	blk.bytes[blk.byte_pos++] = 0xAF;
+	blk.bytes[blk.byte_pos++] = modrm(3, (dest & 7), (source & 7));
+}
+// MUL r/m64
+inline void mul_r(JIT_Block& blk, char source)
+{
+	// RDX:RAX = RAX * source, unsigned
+	blk.bytes[blk.byte_pos++] = rex(1, 0, 0, (source > 7));
+	blk.bytes[blk.byte_pos++] = 0xF7;
+	blk.bytes[blk.byte_pos++] = modrm(3, 0b100, (source & 7));
+}
+// IMUL r/m64
+inline void imul_r(JIT_Block& blk, char source)
+{
+	// RDX:RAX = RAX * source, signed
+	blk.bytes[blk.byte_pos++] = rex(1, 0, 0, (source > 7));
+	blk.bytes[blk.byte_pos++] = 0xF7;
+	blk.bytes[blk.byte_pos++] = modrm(3, 0b101, (source & 7));
+}
+// DIV r/m64
+inline void div_r(JIT_Block& blk, char source)
+{
+	// RAX = RDX:RAX / source, RDX = remainder. Zero divisor raises #DE
+	blk.bytes[blk.byte_pos++] = rex(1, 0, 0, (source > 7));
+	blk.bytes[blk.byte_pos++] = 0xF7;
+	blk.bytes[blk.byte_pos++] = modrm(3, 0b110, (source & 7));
+}
+// DIV r/m32
+inline void div_r32(JIT_Block& blk, char source)
+{
+	// EAX = EDX:EAX / source, EDX = remainder. Zero divisor raises #DE
+	blk.bytes[blk.byte_pos++] = rex(0, 0, 0, (source > 7));
+	blk.bytes[blk.byte_pos++] = 0xF7;
+	blk.bytes[blk.byte_pos++] = modrm(3, 0b110, (source & 7));
+}
+// IDIV r/m64
+inline void idiv_r(JIT_Block& blk, char source)
+{
+	// Signed DIV, INT64_MIN / -1 raises #DE too
+	blk.bytes[blk.byte_pos++] = rex(1, 0, 0, (source > 7));
+	blk.bytes[blk.byte_pos++] = 0xF7;
+	blk.bytes[blk.byte_pos++] = modrm(3, 0b111, (source & 7));
+}
+// IDIV r/m32
+inline void idiv_r32(JIT_Block& blk, char source)
+{
+	// Signed DIV, INT32_MIN / -1 raises #DE too
+	blk.bytes[blk.byte_pos++] = rex(0, 0, 0, (source > 7));
+	blk.bytes[blk.byte_pos++] = 0xF7;
+	blk.bytes[blk.byte_pos++] = modrm(3, 0b111, (source & 7));
+}
+// NEG r/m64
+inline void neg_r(JIT_Block& blk, char dest)
+{
+	// dest is RM, REG is 3
+	blk.bytes[blk.byte_pos++] = rex(1, 0, 0, (dest > 7));
+	blk.bytes[blk.byte_pos++] = 0xF7;
+	blk.bytes[blk.byte_pos++] = modrm(3, 0b011, (dest & 7));
+}
+// NEG r/m32
+inline void neg_r32(JIT_Block& blk, char dest)
+{
+	// dest is RM, REG is 3
+	blk.bytes[blk.byte_pos++] = rex(0, 0, 0, (dest > 7));
+	blk.bytes[blk.byte_pos++] = 0xF7;
+	blk.bytes[blk.byte_pos++] = modrm(3, 0b011, (dest & 7));
+}
+// CQO, sign-extends RAX into RDX
+inline void cqo(JIT_Block& blk)
+{
+	blk.bytes[blk.byte_pos++] = rex(1, 0, 0, 0);
+	blk.bytes[blk.byte_pos++] = 0x99;
+}
+// CDQ, sign-extends EAX into EDX
+inline void cdq(JIT_Block& blk)
+{
+	blk.bytes[blk.byte_pos++] = 0x99;
+}
 // MOV r/m64, r64
 inline void mov(JIT_Block& blk, char dest, char source)
 {
@@ -606,6 +699,40 @@ inline void cmp(JIT_Block& blk, char dest, char source)
 	blk.bytes[blk.byte_pos++] = 0x39;
 	blk.bytes[blk.byte_pos++] = modrm(3, source & 7, dest & 7);
 }
+// CMP r/m64, imm8
+inline void cmp_rimm8(JIT_Block& blk, char dest, int8_t imm8)
+{
+	// dest is RM, REG is 7, imm8 is sign-extended
+	blk.bytes[blk.byte_pos++] = rex(1, 0, 0, (dest > 7));
+	blk.bytes[blk.byte_pos++] = 0x83;
+	blk.bytes[blk.byte_pos++] = modrm(3, 0b111, (dest & 7));
+	blk.bytes[blk.byte_pos++] = (uint8_t)imm8;
+}
+// CMP r/m32, imm8
+inline void cmp_r32imm8(JIT_Block& blk, char dest, int8_t imm8)
+{
+	// dest is RM, REG is 7, imm8 is sign-extended
+	blk.bytes[blk.byte_pos++] = rex(0, 0, 0, (dest > 7));
+	blk.bytes[blk.byte_pos++] = 0x83;
+	blk.bytes[blk.byte_pos++] = modrm(3, 0b111, (dest & 7));
+	blk.bytes[blk.byte_pos++] = (uint8_t)imm8;
+}
+// TEST r/m64, r64
+inline void test_rr(JIT_Block& blk, char dest, char source)
+{
+	// dest is RM, source is REG
+	blk.bytes[blk.byte_pos++] = rex(1, (source > 7), 0, (dest > 7));
+	blk.bytes[blk.byte_pos++] = 0x85;
+	blk.bytes[blk.byte_pos++] = modrm(3, source & 7, dest & 7);
+}
+// TEST r/m32, r32
+inline void test_rr32(JIT_Block& blk, char dest, char source)
+{
+	// dest is RM, source is REG
+	blk.bytes[blk.byte_pos++] = rex(0, (source > 7), 0, (dest > 7));
+	blk.bytes[blk.byte_pos++] = 0x85;
+	blk.bytes[blk.byte_pos++] = modrm(3, source & 7, dest & 7);
+}
 // CMP r64,r/m64
 inline void cmp_rm(JIT_Block& blk, char dest, char reg_base, char reg_index, char scale, int32_t disp = 0)
 {
@@ -660,6 +787,24 @@ inline void setb(JIT_Block& blk, char dest)
 	blk.bytes[blk.byte_pos++] = 0x92;
 	blk.bytes[blk.byte_pos++] = modrm(3, 0, dest & 7);
 }
+// LOCK BTS m64, r64 (bit offset may point past the addressed qword)
+inline void lock_bts_mr(JIT_Block& blk, uint8_t bit, uint8_t reg_base, int32_t disp = 0)
+{
+	// bit is REG, base is RM
+	blk.bytes[blk.byte_pos++] = 0xF0;
+	blk.bytes[blk.byte_pos++] = rex(1, (bit > 7), 0, (reg_base > 7));
+	blk.bytes[blk.byte_pos++] = 0x0F;
+	blk.bytes[blk.byte_pos++] = 0xAB;
+	sib_helper(blk, bit, reg_base, NO_INDEX, 0, disp);
+}
+// LOCK INC m32
+inline void lock_inc_m32(JIT_Block& blk, uint8_t reg_base, uint8_t reg_index, uint8_t scale, int32_t disp = 0)
+{
+	blk.bytes[blk.byte_pos++] = 0xF0;
+	blk.bytes[blk.byte_pos++] = rex(0, 0, (reg_index != NO_INDEX && reg_index > 7), (reg_base > 7));
+	blk.bytes[blk.byte_pos++] = 0xFF;
+	sib_helper(blk, 0, reg_base, reg_index, scale, disp);
+}
 using Jmp8Signature = void (*)(JIT_Block&, int8_t);
 // JE rel8
 inline void je8(JIT_Block& blk, int8_t rel8)
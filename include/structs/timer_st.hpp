@@ -24,6 +24,8 @@ typedef struct
 {
 	uint64_t begin;
 	uint64_t freq;
+	// Guest clock in nanoseconds used instead of host one, nullptr for real time
+	const uint64_t* virt_ns;
 } timer_st;
 
 inline uint64_t timer_clocksource(uint64_t freq)
@@ -33,26 +35,33 @@ inline uint64_t timer_clocksource(uint64_t freq)
 	uint64_t ns	  = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
 	return (ns * freq) / 1000000000ULL;
 }
+inline uint64_t timer_convert_freq(uint64_t clk, uint64_t src_freq, uint64_t dst_freq)
+{
+	uint64_t clk_div = clk / src_freq;
+	uint64_t clk_rem = clk - (clk_div * src_freq);
+	return (clk_div * dst_freq) + (clk_rem * dst_freq / src_freq);
+}
+inline uint64_t timer_now(timer_st* timer)
+{
+	if(timer->virt_ns)
+		return timer_convert_freq(*timer->virt_ns, 1000000000ULL, timer->freq);
+	return timer_clocksource(timer->freq);
+}
 inline uint64_t timer_freq(timer_st* timer)
 {
 	return timer->freq;
 }
 inline uint64_t timer_get(timer_st* timer)
 {
-	return timer_clocksource(timer->freq) - timer->begin;
+	return timer_now(timer) - timer->begin;
 }
 inline void timer_set(timer_st* timer, uint64_t time)
 {
-	timer->begin = timer_clocksource(timer->freq) - time;
+	timer->begin = timer_now(timer) - time;
 }
-inline void timer_init(timer_st* timer, uint64_t freq)
+inline void timer_init(timer_st* timer, uint64_t freq, const uint64_t* virt_ns = nullptr)
 {
-	timer->freq = freq;
+	timer->freq	   = freq;
+	timer->virt_ns = virt_ns;
 	timer_set(timer, 0);
 }
-inline uint64_t timer_convert_freq(uint64_t clk, uint64_t src_freq, uint64_t dst_freq)
-{
-	uint64_t clk_div = clk / src_freq;
-	uint64_t clk_rem = clk - (clk_div * src_freq);
-	return (clk_div * dst_freq) + (clk_rem * dst_freq / src_freq);
-}
@@ -0,0 +1,100 @@
+/*
+Copyright 2026 Spalishe
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One bit per page, shared by every writer of guest memory
+struct DirtyBitmap
+{
+	std::atomic<uint64_t>* words = nullptr;
+	size_t pages				 = 0;
+
+	DirtyBitmap() = default;
+	DirtyBitmap(const DirtyBitmap&)			   = delete;
+	DirtyBitmap& operator=(const DirtyBitmap&) = delete;
+	~DirtyBitmap()
+	{
+		disable();
+	}
+
+	bool enabled() const
+	{
+		return words != nullptr;
+	}
+	size_t word_count() const
+	{
+		return (pages + 63) / 64;
+	}
+
+	// Starts tracking with every page clean
+	void enable(size_t page_count)
+	{
+		if(words) return;
+		pages = page_count;
+		words = new std::atomic<uint64_t>[word_count()];
+		clear();
+	}
+	// Writers must be stopped, they may still hold the pointer
+	void disable()
+	{
+		delete[] words;
+		words = nullptr;
+		pages = 0;
+	}
+
+	// Bit is read first, so rewriting dirty page costs no locked instruction
+	inline void mark(uint64_t page)
+	{
+		std::atomic<uint64_t>& w = words[page >> 6];
+		uint64_t bit			 = 1ULL << (page & 63);
+		if(!(w.load(std::memory_order_relaxed) & bit))
+			w.fetch_or(bit, std::memory_order_relaxed);
+	}
+	void mark_range(uint64_t first, uint64_t last)
+	{
+		for(uint64_t page = first; page <= last && page < pages; page++)
+			mark(page);
+	}
+
+	bool test(uint64_t page) const
+	{
+		return words[page >> 6].load(std::memory_order_relaxed) & (1ULL << (page & 63));
+	}
+
+	void clear()
+	{
+		for(size_t i = 0; i < word_count(); i++)
+			words[i].store(0, std::memory_order_relaxed);
+	}
+
+	// Moves current bits into out and clears them, pages dirtied meanwhile are never lost
+	size_t collect(std::vector<uint64_t>& out)
+	{
+		size_t count = 0;
+		out.resize(word_count());
+		for(size_t i = 0; i < word_count(); i++)
+		{
+			out[i] = words[i].exchange(0, std::memory_order_acq_rel);
+			count += __builtin_popcountll(out[i]);
+		}
+		return count;
+	}
+};
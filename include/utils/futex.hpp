@@ -0,0 +1,47 @@
+/*
+Copyright 2026 Spalishe
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// std::atomic::wait has no timeout, so sleeping up to a deadline goes to the kernel directly.
+// Waiters and wakers of one word must both use these, std::atomic::notify may skip the syscall.
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+// Sleeps while word equals expected, at most timeout_ns (UINT64_MAX for no limit)
+inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, uint64_t timeout_ns = UINT64_MAX)
+{
+	timespec ts;
+	timespec* tsp = nullptr;
+	if(timeout_ns != UINT64_MAX)
+	{
+		ts.tv_sec  = timeout_ns / 1000000000ULL;
+		ts.tv_nsec = timeout_ns % 1000000000ULL;
+		tsp		   = &ts;
+	}
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, tsp, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t>& word, int count = 1)
+{
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
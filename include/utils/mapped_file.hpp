@@ -0,0 +1,77 @@
+/*
+Copyright 2026 Spalishe
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only view of the whole file, used to copy images straight into guest memory
+struct MappedFile
+{
+	const char* data = nullptr;
+	size_t size		 = 0;
+
+	MappedFile() = default;
+	explicit MappedFile(FILE* file)
+	{
+		if(file != nullptr) map(fileno(file));
+	}
+	explicit MappedFile(const std::string& path)
+	{
+		int fd = open(path.c_str(), O_RDONLY);
+		if(fd < 0) return;
+		map(fd);
+		close(fd); // Mapping keeps its own reference
+	}
+	MappedFile(const MappedFile&)			 = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile()
+	{
+		if(data != nullptr)
+			munmap((void*)data, size);
+	}
+
+	bool valid() const
+	{
+		return data != nullptr;
+	}
+
+	// Returns file size without mapping it
+	static size_t size_of(FILE* file)
+	{
+		struct stat st;
+		if(file == nullptr || fstat(fileno(file), &st) != 0) return 0;
+		return st.st_size;
+	}
+
+  private:
+	void map(int fd)
+	{
+		struct stat st;
+		if(fstat(fd, &st) != 0 || st.st_size == 0) return;
+		void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(p == MAP_FAILED) return;
+		madvise(p, st.st_size, MADV_SEQUENTIAL);
+		data = (const char*)p;
+		size = st.st_size;
+	}
+};
@@ -0,0 +1,296 @@
+/*
+Copyright 2026 Spalishe
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#include "../include/blockcache.hpp"
+#include "../include/hart.hpp"
+
+// Instruction may write pc, so nothing can follow it in block
+static bool ends_block(uint32_t inst)
+{
+	if((inst & 3) != 3)
+	{
+		uint32_t funct3 = (inst >> 13) & 7;
+		switch(inst & 3)
+		{
+			case 1:
+				return funct3 == 5 || funct3 == 6 || funct3 == 7; // C.J, C.BEQZ, C.BNEZ
+			case 2:
+				return funct3 == 4 && ((inst >> 2) & 0x1f) == 0; // C.JR, C.JALR, C.EBREAK
+		}
+		return false;
+	}
+	switch(inst & 0x7f)
+	{
+		case 0x63: // BRANCH
+		case 0x67: // JALR
+		case 0x6f: // JAL
+		case 0x73: // SYSTEM
+			return true;
+		case 0x0f: // FENCE.I
+			return ((inst >> 12) & 7) == 1;
+	}
+	return false;
+}
+
+// Macro-op fusion: fixed pairs compilers emit run as one op that retires both instructions.
+// Fused op changes nothing when it fails, exec_block then steps the pair one by one so trap stays precise
+
+// lui + addi/addiw, imm is whole constant
+static ExecReturn fused_LI(Hart& hart, InstructionData& data)
+{
+	hart.GPR[data.rd] = data.imm;
+	return { true, false, 8, 0, 0 };
+}
+// auipc + addi
+static ExecReturn fused_LA(Hart& hart, InstructionData& data)
+{
+	hart.GPR[data.rd] = hart.pc + (int64_t)data.imm;
+	return { true, false, 8, 0, 0 };
+}
+// auipc + jalr with same register as link
+static ExecReturn fused_CALL(Hart& hart, InstructionData& data)
+{
+	uint64_t link	  = hart.pc + 8;
+	hart.pc			  = (hart.pc + (int64_t)data.imm) & ~1ULL;
+	hart.GPR[data.rd] = link;
+	return { true, true, 0, 0, 0 };
+}
+// auipc + ld, GOT load
+static ExecReturn fused_LD_PC(Hart& hart, InstructionData& data)
+{
+	uint64_t val;
+	if(!hart.load(hart.pc + (int64_t)data.imm, &val).is_success) return { false, false, 0, 0, 0 };
+	hart.GPR[data.rd] = val;
+	return { true, false, 8, 0, 0 };
+}
+// add + ld, indexed load
+static ExecReturn fused_LD_IDX(Hart& hart, InstructionData& data)
+{
+	uint64_t val;
+	if(!hart.load(hart.GPR[data.rs1] + hart.GPR[data.rs2] + (int64_t)data.imm, &val).is_success) return { false, false, 0, 0, 0 };
+	hart.GPR[data.rd] = val;
+	return { true, false, 8, 0, 0 };
+}
+// slli + srli by same amount, zero-extension
+static ExecReturn fused_ZEXT(Hart& hart, InstructionData& data)
+{
+	hart.GPR[data.rd] = (hart.GPR[data.rs1] << data.imm) >> data.imm;
+	return { true, false, 8, 0, 0 };
+}
+// li + branch against it. imm is branch offset, constant is kept in inst
+template <uint32_t funct3>
+static ExecReturn fused_LI_BRANCH(Hart& hart, InstructionData& data)
+{
+	uint64_t a = hart.GPR[data.rs1];
+	uint64_t b = (int64_t)(int32_t)data.inst;
+	bool taken;
+	switch(funct3)
+	{
+		case 0: taken = a == b; break;
+		case 1: taken = a != b; break;
+		case 4: taken = (int64_t)a < (int64_t)b; break;
+		case 5: taken = (int64_t)a >= (int64_t)b; break;
+		case 6: taken = a < b; break;
+		default: taken = a >= b; break;
+	}
+	uint64_t target = hart.pc + 4 + (int64_t)data.imm;
+	if(taken && target % 2 != 0) return { false, false, 0, 0, 0 };
+	hart.GPR[data.rd] = b;
+	if(!taken) return { true, false, 8, 0, 0 };
+	hart.pc = target;
+	return { true, true, 0, 0, 0 };
+}
+
+// Turns op of 32-bit instruction a into fused op covering it and following 32-bit instruction b, false if pair is no known idiom
+static bool fuse(uint32_t a, uint32_t b, PredecodedOp& op)
+{
+	uint32_t op_a = a & 0x7f, f3_a = (a >> 12) & 7, rd_a = (a >> 7) & 0x1f, rs1_a = (a >> 15) & 0x1f;
+	uint32_t op_b = b & 0x7f, f3_b = (b >> 12) & 7, rd_b = (b >> 7) & 0x1f, rs1_b = (b >> 15) & 0x1f;
+	if(rd_a == 0) return false;
+	InstructionData data = op.data;
+	data.rd				 = rd_a;
+	ExecReturn (*func)(Hart& h, InstructionData& data);
+	// Second instruction consumes and overwrites result of first one
+	bool chained = rs1_b == rd_a && rd_b == rd_a;
+
+	if(op_a == 0x37 && chained && f3_b == 0 && (op_b == 0x13 || op_b == 0x1b)) // LUI + ADDI/ADDIW
+	{
+		data.imm = imm_U(a) + imm_I(b);
+		if(op_b == 0x1b) data.imm = (int64_t)(int32_t)data.imm;
+		func = fused_LI;
+	}
+	else if(op_a == 0x17 && chained && f3_b == 0 && op_b == 0x13) // AUIPC + ADDI
+	{
+		data.imm = imm_U(a) + imm_I(b);
+		func	 = fused_LA;
+	}
+	else if(op_a == 0x17 && chained && f3_b == 0 && op_b == 0x67) // AUIPC + JALR
+	{
+		data.imm = imm_U(a) + imm_I(b);
+		func	 = fused_CALL;
+	}
+	else if(op_a == 0x17 && chained && f3_b == 3 && op_b == 0x03) // AUIPC + LD
+	{
+		data.imm = imm_U(a) + imm_I(b);
+		func	 = fused_LD_PC;
+	}
+	else if(op_a == 0x33 && f3_a == 0 && (a >> 25) == 0 && chained && f3_b == 3 && op_b == 0x03) // ADD + LD
+	{
+		data.rs1 = rs1_a;
+		data.rs2 = (a >> 20) & 0x1f;
+		data.imm = imm_I(b);
+		func	 = fused_LD_IDX;
+	}
+	else if(op_a == 0x13 && f3_a == 1 && (a >> 26) == 0 && chained && op_b == 0x13 && f3_b == 5 && (b >> 20) == (a >> 20)) // SLLI + SRLI
+	{
+		data.rs1 = rs1_a;
+		data.imm = (a >> 20) & 0x3f;
+		func	 = fused_ZEXT;
+	}
+	else if(op_a == 0x13 && f3_a == 0 && rs1_a == 0 && op_b == 0x63 && ((b >> 20) & 0x1f) == rd_a && rs1_b != rd_a) // LI + BRANCH
+	{
+		data.rs1  = rs1_b;
+		data.imm  = imm_B(b);
+		data.inst = (uint32_t)imm_I(a);
+		switch(f3_b)
+		{
+			case 0: func = fused_LI_BRANCH<0>; break;
+			case 1: func = fused_LI_BRANCH<1>; break;
+			case 4: func = fused_LI_BRANCH<4>; break;
+			case 5: func = fused_LI_BRANCH<5>; break;
+			case 6: func = fused_LI_BRANCH<6>; break;
+			case 7: func = fused_LI_BRANCH<7>; break;
+			default: return false;
+		}
+	}
+	else
+		return false;
+	op.func	 = func;
+	op.data	 = data;
+	op.size	 = 8;
+	op.insts = 2;
+	return true;
+}
+
+void BlockCache::flush()
+{
+	for(auto& blk : blocks)
+		blk.paddr = ~0ULL;
+	ops.clear();
+}
+
+CodeBlock* BlockCache::build(const InstructionDecoder* idec, MemoryMap* mmap, CodeBlock& blk, uint64_t paddr)
+{
+	MemoryRegion* ram = mmap->ram_direct;
+	if(paddr < ram->base_addr || paddr >= ram->base_addr + ram->size)
+		return nullptr; // Only DRAM has write generations
+	if(ops.size() + BLOCK_MAX_OPS > BLOCK_ARENA_OPS)
+		flush();
+
+	uint64_t page_end = (paddr & ~(PAGE_SIZE - 1)) + PAGE_SIZE;
+	uint32_t first	  = ops.size();
+	uint64_t addr	  = paddr;
+	uint32_t prev_inst = 0;
+	bool prev_fusable  = false;
+	while(addr < page_end && ops.size() - first < BLOCK_MAX_OPS)
+	{
+		uint32_t inst = 0;
+		memcpy(&inst, ram->data + (addr - ram->base_addr), page_end - addr >= 4 ? 4 : 2);
+		uint8_t size = (inst & 3) == 3 ? 4 : 2;
+		if(addr + size > page_end)
+			break; // Second half lives on other page
+		if(size == 2)
+			inst &= 0xFFFF;
+
+		const Instruction* dinst = idec->find_inst(inst);
+		if(dinst == nullptr)
+			break; // Illegal instruction traps from single step path
+		bool last = ends_block(inst);
+		addr += size;
+		// Pair up with previous plain 32-bit op when they form an idiom
+		if(size == 4 && prev_fusable && fuse(prev_inst, inst, ops.back()))
+		{
+			prev_fusable = false;
+			if(last)
+				break;
+			continue;
+		}
+		ops.push_back({ dinst->func, InstructionDecoder::decode_data(dinst, inst), size, (inst & 0x7f) == 0x73 });
+		prev_inst	 = inst;
+		prev_fusable = size == 4;
+		if(last)
+			break;
+	}
+	if(ops.size() == first)
+		return nullptr;
+
+	blk.paddr = paddr;
+	blk.page  = (paddr - ram->base_addr) >> PAGE_SHIFT;
+	blk.gen	  = mmap->page_gen[blk.page].load(std::memory_order_relaxed);
+	blk.first = first;
+	blk.count = ops.size() - first;
+	return &blk;
+}
+
+void DecodeCache::flush()
+{
+	for(auto& [page, pg] : pages)
+		delete pg;
+	pages.clear();
+	last	  = nullptr;
+	last_page = ~0u;
+}
+
+void DecodeCache::get_page(uint32_t page)
+{
+	auto it = pages.find(page);
+	if(it == pages.end())
+	{
+		if(pages.size() >= DECODE_MAX_PAGES)
+			flush();
+		it = pages.emplace(page, new DecodedPage()).first;
+	}
+	last	  = it->second;
+	last_page = page;
+}
+
+InstructionCache* DecodeCache::decode(const InstructionDecoder* idec, MemoryMap* mmap, uint64_t off)
+{
+	MemoryRegion* ram = mmap->ram_direct;
+	uint64_t in_page  = off & (PAGE_SIZE - 1);
+	uint32_t inst	  = 0;
+	memcpy(&inst, ram->data + off, in_page <= PAGE_SIZE - 4 ? 4 : 2);
+	if((inst & 3) == 3)
+	{
+		if(in_page > PAGE_SIZE - 4)
+			return nullptr; // Second half lives on other page, may be mapped anywhere
+	}
+	else
+		inst &= 0xFFFF;
+
+	// Entry of stale instruction is decoded again in place
+	uint16_t& idx = last->slot[in_page >> 1];
+	if(idx == 0)
+	{
+		last->entries.emplace_back();
+		idx = last->entries.size();
+	}
+	InstructionCache& entry = last->entries[idx - 1];
+	idec->decode_into(entry, inst);
+	entry.gen = mmap->page_gen[off >> PAGE_SHIFT].load(std::memory_order_relaxed);
+	return &entry;
+}
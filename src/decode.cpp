@@ -16,29 +16,141 @@ Copyright 2026 Spalishe
 */
 
 #include "../include/decode.hpp"
+#include <algorithm>
 #include <assert.h>
 #include <bitset>
 #include <cstdio>
 
-__attribute__((noinline)) InstructionCache& InstructionDecoder::decode_inst_slow(uint64_t pc, uint32_t inst)
+const InstructionDecoder* InstructionDecoder::shared()
 {
-	size_t idx = (pc >> 2) & (CACHE_SIZE - 1);
+	// Thread-safe static, instructions are registered and sorted into buckets exactly once
+	static const InstructionDecoder* decoder = []()
+	{
+		InstructionDecoder* dec = new InstructionDecoder();
+		dec->init_all_instrs();
+		return dec;
+	}();
+	return decoder;
+}
+
+void InstructionDecoder::decode_into(InstructionCache& entry, uint32_t inst) const
+{
+	const Instruction* dinst = find_inst(inst);
+	entry.inst_raw			 = inst;
+	entry.inst				 = dinst;
+	entry.data				 = decode_data(dinst, inst);
+	entry.valid				 = dinst != nullptr;
+}
 
-	const Instruction* dinst = nullptr;
+static inline uint32_t enc_r(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode)
+{
+	return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+static inline uint32_t enc_i(uint32_t imm, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode)
+{
+	return ((imm & 0xfff) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+static inline uint32_t enc_s(uint32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t opcode)
+{
+	return (((imm >> 5) & 0x7f) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | ((imm & 0x1f) << 7) | opcode;
+}
 
-	if((inst & 0x3) != 0x3)
+uint32_t InstructionDecoder::expand_compressed(uint16_t inst)
+{
+	uint32_t funct3 = (inst >> 13) & 0x7;
+	uint32_t rd		= (inst >> 7) & 0x1f; // Also rs1
+	uint32_t rs2	= d_c_rs2(inst);
+	uint32_t rd_p	= 8 + d_c_rd(inst); // Also rs2'
+	uint32_t rs1_p	= 8 + d_c_rs1(inst);
+	switch(inst & 0x3)
 	{
-		uint32_t lut_idx = _pext_u32(inst & 0xFFFF, HASH_MASK_16);
-		dinst			 = lut16[lut_idx];
+		case 0:
+			switch(funct3)
+			{
+				case 0: // C.ADDI4SPN
+					if(d_c_uimm(inst) == 0) return 0;
+					return enc_i(d_c_uimm(inst), 2, 0, rd_p, 0x13);
+				case 1: return enc_i(d_c_uimm_cl1(inst), rs1_p, 3, rd_p, 0x07); // C.FLD
+				case 2: return enc_i(d_c_uimm_cl(inst), rs1_p, 2, rd_p, 0x03);	// C.LW
+				case 3: return enc_i(d_c_uimm_cl1(inst), rs1_p, 3, rd_p, 0x03); // C.LD
+				case 5: return enc_s(d_c_uimm_cl1(inst), rd_p, rs1_p, 3, 0x27); // C.FSD
+				case 6: return enc_s(d_c_uimm_cl(inst), rd_p, rs1_p, 2, 0x23);	// C.SW
+				case 7: return enc_s(d_c_uimm_cl1(inst), rd_p, rs1_p, 3, 0x23); // C.SD
+			}
+			return 0;
+		case 1:
+			switch(funct3)
+			{
+				case 0: return enc_i(d_c_nzimm(inst), rd, 0, rd, 0x13); // C.ADDI, C.NOP
+				case 1:													// C.ADDIW
+					if(rd == 0) return 0;
+					return enc_i(d_c_nzimm(inst), rd, 0, rd, 0x1b);
+				case 2: return enc_i(d_c_nzimm(inst), 0, 0, rd, 0x13); // C.LI
+				case 3:
+					if(rd == 2) // C.ADDI16SP
+					{
+						if(d_c_nzimm_9(inst) == 0) return 0;
+						return enc_i(d_c_nzimm_9(inst), 2, 0, 2, 0x13);
+					}
+					if(d_c_nzimm(inst) == 0) return 0; // C.LUI
+					return ((uint32_t)d_c_nzimm(inst) << 12) | (rd << 7) | 0x37;
+				case 4:
+					switch((inst >> 10) & 0x3)
+					{
+						case 0: return enc_i(d_c_uimm_arith(inst), rs1_p, 5, rs1_p, 0x13);		   // C.SRLI
+						case 1: return enc_i(0x400 | d_c_uimm_arith(inst), rs1_p, 5, rs1_p, 0x13); // C.SRAI
+						case 2: return enc_i(d_c_nzimm(inst), rs1_p, 7, rs1_p, 0x13);			   // C.ANDI
+					}
+					switch(((inst >> 10) & 0x4) | ((inst >> 5) & 0x3))
+					{
+						case 0: return enc_r(0x20, rd_p, rs1_p, 0, rs1_p, 0x33); // C.SUB
+						case 1: return enc_r(0x00, rd_p, rs1_p, 4, rs1_p, 0x33); // C.XOR
+						case 2: return enc_r(0x00, rd_p, rs1_p, 6, rs1_p, 0x33); // C.OR
+						case 3: return enc_r(0x00, rd_p, rs1_p, 7, rs1_p, 0x33); // C.AND
+						case 4: return enc_r(0x20, rd_p, rs1_p, 0, rs1_p, 0x3b); // C.SUBW
+						case 5: return enc_r(0x00, rd_p, rs1_p, 0, rs1_p, 0x3b); // C.ADDW
+					}
+					return 0;
+			}
+			return 0; // C.J, C.BEQZ, C.BNEZ
+		case 2:
+			switch(funct3)
+			{
+				case 0: return enc_i(d_c_uimm_arith(inst), rd, 1, rd, 0x13); // C.SLLI
+				case 1: return enc_i(d_c_uimm_ldsp(inst), 2, 3, rd, 0x07);	 // C.FLDSP
+				case 2:														 // C.LWSP
+					if(rd == 0) return 0;
+					return enc_i(d_c_uimm_lwsp(inst), 2, 2, rd, 0x03);
+				case 3: // C.LDSP
+					if(rd == 0) return 0;
+					return enc_i(d_c_uimm_ldsp(inst), 2, 3, rd, 0x03);
+				case 4:
+					if(rs2 == 0) return 0; // C.JR, C.JALR, C.EBREAK
+					if((inst >> 12) & 1)
+						return enc_r(0, rs2, rd, 0, rd, 0x33); // C.ADD
+					return enc_r(0, rs2, 0, 0, rd, 0x33);	   // C.MV
+				case 5: return enc_s(d_c_uimm_sdsp(inst), rs2, 2, 3, 0x27); // C.FSDSP
+				case 6: return enc_s(d_c_uimm_swsp(inst), rs2, 2, 2, 0x23); // C.SWSP
+				case 7: return enc_s(d_c_uimm_sdsp(inst), rs2, 2, 3, 0x23); // C.SDSP
+			}
 	}
+	return 0;
+}
 
-	if(!dinst)
+const Instruction* InstructionDecoder::find_inst(uint32_t inst) const
+{
+	uint32_t b = bucket_index(inst);
+	for(uint32_t i = bucket_start[b]; i < bucket_start[b + 1]; i++)
 	{
-		uint32_t lut_idx = _pext_u32(inst, HASH_MASK);
-		dinst			 = lut[lut_idx];
+		const Instruction* dinst = candidates[i];
+		if((inst & dinst->mask) == dinst->match)
+			return dinst;
 	}
+	return nullptr;
+}
 
-	bool f = (dinst != nullptr) && ((inst & dinst->mask) == dinst->match);
+InstructionData InstructionDecoder::decode_data(const Instruction* dinst, uint32_t inst)
+{
 	InstructionData data;
 	data.inst = inst;
 	data.rd	  = d_rd(inst);
@@ -48,35 +160,8 @@ __attribute__((noinline)) InstructionCache& InstructionDecoder::decode_inst_slow
 	data.rs3 = d_rs3(inst);
 	data.rm	 = d_rm(inst);
 #endif
-
-	CacheSet& set			= cache[idx];
-	InstructionCache& entry = set.ways[set.victim];
-	set.victim ^= 1;
-
-	if(f) [[likely]]
-	{
-		data.imm	   = dinst->imm_decode_func(inst);
-		// cache[idx] = { pc, inst, dinst, data, true };
-		entry.pc	   = pc;
-		entry.inst_raw = inst;
-		entry.inst	   = dinst;
-		entry.data	   = data;
-		entry.valid	   = true;
-	}
-	else
-	{
-		data.imm = 0;
-		Instruction* invalid_inst{};
-		// cache[idx] = { pc, inst, invalid_inst, data, false };
-		entry.pc	   = pc;
-		entry.inst_raw = inst;
-		entry.inst	   = invalid_inst;
-		entry.data	   = data;
-		entry.valid	   = false;
-	}
-
-	// printf("inst=0x%lx match=0x%lx mask=0x%lx func=%p\n", inst, dinst->match, dinst->mask, dinst->func);
-	return entry;
+	data.imm = dinst != nullptr ? dinst->imm_decode_func(inst) : 0;
+	return data;
 }
 
 void InstructionDecoder::register_instr(std::string mask, ExecReturn (*func)(Hart&, InstructionData&), uint64_t (*imm_decode_func)(uint32_t inst))
@@ -110,11 +195,6 @@ void InstructionDecoder::register_instr(std::string mask, ExecReturn (*func)(Har
 	};
 	// printf("Registered instr mask=0x%dx match=0x%dx with func=%p, imm_decode_func=%p\n", inst_mask, inst_match, func, imm_decode_func);
 	instructions.push_back(inst);
-	// std::string opcode_str = mask.substr(mask.length() - 7);
-	// std::bitset<7> bits(opcode_str);
-	// unsigned long opcode = bits.to_ulong();
-	// opcode_table[opcode].push_back(inst);
-	global_hash_mask |= inst_mask;
 }
 
 void InstructionDecoder::init_all_instrs()
@@ -136,47 +216,38 @@ void InstructionDecoder::init_all_instrs()
 	init_zbc();
 	init_zbs();
 	init_zicboz();
-	build_lut();
+	build_table();
 }
-void InstructionDecoder::build_lut()
+void InstructionDecoder::build_table()
 {
+	// Opcode and funct3 bits of every bucket, instruction goes to each bucket it can match in
+	constexpr uint32_t FIELDS_32 = 0x0000707F;
+	constexpr uint32_t FIELDS_16 = 0x0000E003;
+
+	std::vector<const Instruction*> buckets[BUCKETS];
 	for(const auto& inst : instructions)
 	{
-		bool is_16bit = (inst.size == 2);
-
-		uint32_t current_hash_mask		= is_16bit ? HASH_MASK_16 : HASH_MASK;
-		size_t current_lut_size			= is_16bit ? LUT_SIZE_16 : LUT_SIZE;
-		const Instruction** current_lut = is_16bit ? lut16 : lut;
-
-		uint32_t effective_mask = inst.mask & current_hash_mask;
-		uint32_t dont_care_bits = current_hash_mask & (~effective_mask);
-
-		uint32_t sub_mask = 0;
-		do
+		bool is_16bit	= (inst.size == 2);
+		uint32_t first	= is_16bit ? BUCKETS_32 : 0;
+		uint32_t last	= is_16bit ? BUCKETS : BUCKETS_32;
+		uint32_t fields = is_16bit ? FIELDS_16 : FIELDS_32;
+		for(uint32_t b = first; b < last; b++)
 		{
-			uint32_t test_inst = (inst.match & current_hash_mask) | sub_mask;
-			uint32_t lut_idx   = _pext_u32(test_inst, current_hash_mask);
-
-			if(lut_idx >= current_lut_size)
-			{
-				printf("[CRITICAL] Index %u out of bounds for %s LUT!\n",
-					   lut_idx, is_16bit ? "16-bit" : "32-bit");
-				continue;
-			}
-
-			if(current_lut[lut_idx] != nullptr)
-			{
-				if(__builtin_popcount(inst.mask) > __builtin_popcount(current_lut[lut_idx]->mask))
-				{
-					current_lut[lut_idx] = &inst;
-				}
-			}
-			else
-			{
-				current_lut[lut_idx] = &inst;
-			}
+			uint32_t i	 = b - first;
+			uint32_t rep = is_16bit ? ((i >> 3) | ((i & 0x7) << 13)) : ((i >> 3) | ((i & 0x7) << 12));
+			if(((rep ^ inst.match) & inst.mask & fields) == 0)
+				buckets[b].push_back(&inst);
+		}
+	}
 
-			sub_mask = (sub_mask - dont_care_bits) & dont_care_bits;
-		} while(sub_mask != 0);
+	candidates.clear();
+	for(uint32_t b = 0; b < BUCKETS; b++)
+	{
+		// More fixed bits wins, ties keep registration order
+		std::stable_sort(buckets[b].begin(), buckets[b].end(), [](const Instruction* a, const Instruction* b)
+		{ return __builtin_popcount(a->mask) > __builtin_popcount(b->mask); });
+		bucket_start[b] = candidates.size();
+		candidates.insert(candidates.end(), buckets[b].begin(), buckets[b].end());
 	}
+	bucket_start[BUCKETS] = candidates.size();
 }
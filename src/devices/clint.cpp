@@ -18,6 +18,7 @@ Copyright 2026 Spalishe
 #include "../../include/devices/clint.hpp"
 #include "../../include/libfdt.hpp"
 #include "../../include/machine.hpp"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <thread>
@@ -28,17 +29,19 @@ CLINT::CLINT(uint64_t start, uint64_t size, Machine& cpu, fdt_node* fdt)
 	  mtimecmp(cpu.harts_count),
 	  cpu(cpu)
 {
-	timer_init(&mtime, cpu.timebase);
+	// Deterministic machine has no host clock, time moves only between quanta
+	virtual_time = cpu.deterministic;
+	timer_init(&mtime, cpu.timebase, virtual_time ? &cpu.virtual_ns : nullptr);
 	for(int i = 0; i < cpu.harts_count; i++)
 	{
 		timecmp_init(&mtimecmp[i], &mtime);
 		timecmp_set(&mtimecmp[i], UINT64_MAX);
-		timecmp_init(&cpu.harts[i].stimecmp, &mtime);
-		timecmp_set(&cpu.harts[i].stimecmp, UINT64_MAX);
 	}
+	attach_harts();
 	cpu.mmap->add_region(start, size);
 	thr_working.store(true);
-	thr	   = std::thread(&CLINT::thread_func, this);
+	if(!virtual_time)
+		thr = std::thread(&CLINT::thread_func, this);
 	countr = 0;
 	if(fdt != NULL)
 	{
@@ -82,16 +85,36 @@ std::shared_ptr<CLINT> CLINT::init_auto(Machine& cpu)
 	return std::make_shared<CLINT>(0x02000000, 0x10000, cpu, cpu.fdt);
 }
 
+void CLINT::attach_harts()
+{
+	for(Hart& hart : cpu.harts)
+	{
+		hart.mtime = &mtime;
+		timecmp_init(&hart.stimecmp, &mtime);
+		timecmp_set(&hart.stimecmp, UINT64_MAX);
+	}
+}
+
 void CLINT::tick()
 {
-	// update_mip();
+	if(virtual_time)
+		update_mip();
 }
 
 void CLINT::thread_func()
 {
 	while(thr_working.load(std::memory_order_acquire))
 	{
-		update_mip();
+		// Paused machine has nobody to deliver timer interrupts to
+		if(cpu.state.load(std::memory_order_acquire) == MachineState::Halted)
+		{
+			cpu.state.wait(MachineState::Halted, std::memory_order_acquire);
+			continue;
+		}
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			update_mip();
+		}
 		std::this_thread::sleep_for(std::chrono::microseconds(100));
 	}
 }
@@ -164,28 +187,43 @@ void CLINT::write_mtimer(uint64_t offset, uint64_t value)
 	update_mip();
 }
 
-void CLINT::update_mip()
+uint64_t CLINT::next_timer_ns(Hart& hart)
 {
+	std::lock_guard<std::mutex> guard(lock);
+	// Timers already raised don't count, only doorbell can change anything then
+	uint64_t deadline = UINT64_MAX;
+	uint16_t raised = hart.irq_lines.load(std::memory_order_relaxed);
+	if(hart.ie.fields.MTIE && !(raised & (1 << MIP_MTIP)))
+		deadline = timecmp_get(&mtimecmp[hart.id]);
+	if(hart.ie.fields.STIE && !(raised & (1 << MIP_STIP)))
+		deadline = std::min(deadline, timecmp_get(&hart.stimecmp));
+	if(deadline == UINT64_MAX) return UINT64_MAX;
+
 	uint64_t now = timer_get(&mtime);
+	if(now >= deadline) return 0;
+	return timer_convert_freq(deadline - now, timer_freq(&mtime), 1000000000ULL);
+}
+
+void CLINT::update_mip()
+{
+	const uint16_t lines = (1 << MIP_MSIP) | (1 << MIP_MTIP) | (1 << MIP_STIP);
+	uint64_t now		 = timer_get(&mtime);
 	for(Hart& hart : cpu.harts)
 	{
-		hart.csrs[CSR_TIME] = now;
-		uint32_t hart_id	= hart.id;
+		uint32_t hart_id = hart.id;
+		uint16_t level	 = 0;
 
 		if(msip[hart_id] & 1)
-			hart.ip.fields.MSIP = 1;
-		else
-			hart.ip.fields.MSIP = 0;
+			level |= 1 << MIP_MSIP;
 
 		if(now >= timecmp_get(&mtimecmp[hart_id]))
-			hart.ip.fields.MTIP = 1;
-		else
-			hart.ip.fields.MTIP = 0;
+			level |= 1 << MIP_MTIP;
 
 		uint64_t stimecmp = timecmp_get(&hart.stimecmp);
 		if(now >= stimecmp && stimecmp != UINT64_MAX)
-			hart.ip.fields.STIP = 1;
-		else
-			hart.ip.fields.STIP = 0;
+			level |= 1 << MIP_STIP;
+
+		// Hart may run or sleep in WFI on another thread
+		hart.drive_irq(lines, level);
 	}
 }
@@ -120,6 +120,8 @@ void PLIC::set_pending(uint32_t source_id, bool pending)
 	if(source_id == 0 || source_id > max_sources)
 		return;
 
+	// Raised by other devices, possibly from another hart's thread
+	std::lock_guard<std::mutex> guard(lock);
 	uint32_t word_idx = source_id / 32;
 	uint32_t bit_mask = 1U << (source_id % 32);
 
@@ -329,23 +331,6 @@ void PLIC::signal_cpu_interrupt(int hart_id, bool supervisor_mode, bool level)
 	if(hart_id < 0 || hart_id >= 64)
 		return;
 
-	Hart& hart = cpu.harts[hart_id];
-
-	const uint64_t MEIP_BIT = 1ULL << 11;
-	const uint64_t SEIP_BIT = 1ULL << 9;
-
-	if(supervisor_mode)
-	{
-		if(level)
-			hart.ip.fields.SEIP = 1;
-		else
-			hart.ip.fields.SEIP = 0;
-	}
-	else
-	{
-		if(level)
-			hart.ip.fields.MEIP = 1;
-		else
-			hart.ip.fields.MEIP = 0;
-	}
+	uint16_t line = 1 << (supervisor_mode ? MIP_SEIP : MIP_MEIP);
+	cpu.harts[hart_id].drive_irq(line, level ? line : 0);
 }
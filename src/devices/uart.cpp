@@ -297,6 +297,8 @@ void UART::write(uint64_t addr, MemorySize size, uint64_t value)
 
 void UART::receive_byte(uint8_t byte)
 {
+	// Comes from input thread, not through MMIO
+	std::lock_guard<std::mutex> guard(lock);
 	// FIFO overflow
 	if(fifo_enabled && fifo_buffer.size() >= 16)
 	{
@@ -0,0 +1,317 @@
+/*
+Copyright 2026 Spalishe
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#include "../../include/devices/virtio_balloon.hpp"
+#include "../../include/machine.hpp"
+
+#include <cstdio>
+
+VirtIO_Balloon::VirtIO_Balloon(uint64_t base, uint64_t size, Machine& cpu, fdt_node* fdt)
+	: Device(base, size, fdt, cpu.mmap), plic(cpu.mmio->get<PLIC>().get()), irq_num(plic->acquire_irq())
+{
+	cpu.mmap->add_region(base, size);
+
+	fdt_node* balloon_node = fdt_node_create_reg("virtio_mmio", base);
+	fdt_node_add_prop(balloon_node, "compatible", "virtio,mmio\0", 12);
+	fdt_node_add_prop_reg(balloon_node, "reg", base, size);
+	fdt_node* soc  = fdt_node_find(fdt, "soc");
+	fdt_node* plic = fdt_node_find_reg(soc, "plic", 0x0C000000);
+	fdt_node_add_prop_u32(balloon_node, "interrupt-parent", fdt_node_get_phandle(plic));
+	fdt_node_free(plic);
+	fdt_node_add_prop_u32(balloon_node, "interrupts", irq_num);
+	fdt_node_add_child(soc, balloon_node);
+	fdt_node_free(soc);
+
+	// Free page hinting is not offered: hinted pages may be reused by guest without telling us,
+	// so the only safe thing to do with them would be nothing
+	device_features = VIRTIO_F_VERSION_1 | VIRTIO_BALLOON_F_DEFLATE_ON_OOM | VIRTIO_BALLOON_F_REPORTING;
+}
+
+std::shared_ptr<VirtIO_Balloon> VirtIO_Balloon::init_auto(Machine& cpu)
+{
+	return std::make_shared<VirtIO_Balloon>(0x10002000, 0x1000, cpu, cpu.fdt);
+}
+
+void VirtIO_Balloon::set_target(uint32_t pages)
+{
+	target_pages.store(pages, std::memory_order_relaxed);
+	target_changed.store(true, std::memory_order_release);
+}
+
+void VirtIO_Balloon::tick()
+{
+	// Target may come from any thread, config change is announced from here
+	if(!target_changed.load(std::memory_order_acquire)) [[likely]]
+		return;
+	target_changed.store(false, std::memory_order_relaxed);
+	if(!(device_status & VIRT_STATUS_DRIVER_OK)) return;
+	config_generation++;
+	interrupt_status |= VIRT_INTERRUPT_CONFIG_CHANGE;
+	raise_irq();
+}
+
+// Descriptor chain fetch
+bool VirtIO_Balloon::fetch_descriptor_chain(uint16_t head, std::vector<VirtqDesc>& out_chain, const VirtQueueState& q)
+{
+	out_chain.clear();
+	if(q.desc_addr == 0) return false;
+	uint16_t idx = head;
+	for(uint32_t iter = 0; iter < q.size; ++iter)
+	{
+		uint64_t desc_addr = q.desc_addr + (uint64_t)idx * VIRTQ_DESC_SIZE;
+		VirtqDesc d;
+		d.addr	= (uint64_t)mmap->load(desc_addr + 0, 64);
+		d.len	= (uint32_t)mmap->load(desc_addr + 8, 32);
+		d.flags = (uint16_t)mmap->load(desc_addr + 12, 16);
+		d.next	= (uint16_t)mmap->load(desc_addr + 14, 16);
+		out_chain.push_back(d);
+		if(d.flags & VIRTQ_DESC_F_NEXT)
+			idx = d.next;
+		else
+			return true;
+	}
+	return false;
+}
+
+void VirtIO_Balloon::discard_pfns(const VirtqDesc& d)
+{
+	std::vector<uint32_t> pfns(d.len / sizeof(uint32_t));
+	if(pfns.empty() || !mmap->copy_mem_safe(d.addr, pfns.size() * sizeof(uint32_t), pfns.data()))
+		return;
+
+	// Linux sends PFNs sorted in runs, so contiguous pages are dropped with single madvise
+	uint64_t run_start = pfns[0];
+	uint64_t run_len   = 1;
+	for(size_t i = 1; i <= pfns.size(); i++)
+	{
+		if(i < pfns.size() && pfns[i] == run_start + run_len)
+		{
+			run_len++;
+			continue;
+		}
+		reclaimed_bytes += mmap->discard(run_start << VIRTIO_BALLOON_PFN_SHIFT, run_len << VIRTIO_BALLOON_PFN_SHIFT);
+		if(i < pfns.size())
+		{
+			run_start = pfns[i];
+			run_len	  = 1;
+		}
+	}
+}
+
+// Queue processing
+void VirtIO_Balloon::process_queue(uint32_t qsel)
+{
+	if(qsel >= VIRTIO_BALLOON_QUEUES) return;
+	VirtQueueState& q = queues[qsel];
+	if(!q.ready || q.size == 0) return;
+
+	uint16_t avail_idx = (uint16_t)mmap->load(q.avail_addr + 2, 16); // flags(2) then idx(2)
+	bool used		   = false;
+
+	std::vector<VirtqDesc> chain;
+	while(q.last_avail_idx != avail_idx)
+	{
+		uint16_t ring_index		 = q.last_avail_idx % q.size;
+		uint64_t ring_entry_addr = q.avail_addr + 4 + (uint64_t)ring_index * 2;
+		uint16_t head			 = (uint16_t)mmap->load(ring_entry_addr, 16);
+
+		if(fetch_descriptor_chain(head, chain, q))
+		{
+			for(const VirtqDesc& d : chain)
+			{
+				switch(qsel)
+				{
+					case VIRTIO_BALLOON_Q_INFLATE:
+						discard_pfns(d);
+						break;
+					case VIRTIO_BALLOON_Q_REPORTING:
+						// Each buffer is one free block of guest memory
+						reclaimed_bytes += mmap->discard(d.addr, d.len);
+						break;
+					default:
+						// Deflated pages are faulted back in on first touch
+						break;
+				}
+			}
+		}
+
+		uint16_t used_ring_idx	= q.last_used_idx % q.size;
+		uint64_t used_elem_addr = q.used_addr + sizeof(uint16_t) * 2 + (uint64_t)used_ring_idx * sizeof(VirtqUsedElem);
+		mmap->store(used_elem_addr + 0, 32, head);
+		mmap->store(used_elem_addr + 4, 32, 0);
+		q.last_used_idx++;
+		q.last_avail_idx++;
+		used = true;
+	}
+
+	if(used)
+	{
+		mmap->store(q.used_addr + 2, 16, q.last_used_idx);
+		interrupt_status |= VIRT_INTERRUPT_USED_BUFFER;
+		raise_irq();
+	}
+}
+
+void VirtIO_Balloon::reset_queues()
+{
+	for(VirtQueueState& q : queues)
+		q = VirtQueueState();
+}
+
+// MMIO read/write
+uint64_t VirtIO_Balloon::read(uint64_t addr, MemorySize size)
+{
+	uint64_t off = addr - start;
+	VirtQueueState* q = queue_sel < VIRTIO_BALLOON_QUEUES ? &queues[queue_sel] : nullptr;
+	switch(off)
+	{
+		case VIRT_REG_MAGICVALUE:
+			return 0x74726976;
+		case VIRT_REG_VERSION:
+			return 0x2;
+		case VIRT_REG_DEVICEID:
+			return VIRTIO_BALLOON_DEVICE_ID;
+		case VIRT_REG_VENDORID:
+			return 0x554d4551;
+		case VIRT_REG_DEVICEFEATURES:
+		{
+			if(device_features_sel == 0)
+				return (uint32_t)(device_features & 0xFFFFFFFF);
+			else
+				return (uint32_t)(device_features >> 32);
+		}
+		case VIRT_REG_DEVICEFEATURESSEL:
+			return device_features_sel;
+		case VIRT_REG_QUEUESEL:
+			return queue_sel;
+		case VIRT_REG_QUEUENUMMAX:
+			return q ? 128 : 0;
+		case VIRT_REG_QUEUENUM:
+			return q ? q->size : 0;
+		case VIRT_REG_QUEUEREADY:
+			return q && q->ready ? 1 : 0;
+		case VIRT_REG_INTERRUPTSTATUS:
+			return interrupt_status;
+		case VIRT_REG_STATUS:
+			return device_status;
+		case VIRT_REG_QUEUEDESCLOW:
+			return q ? (uint32_t)(q->desc_addr & 0xFFFFFFFF) : 0;
+		case VIRT_REG_QUEUEDESCHIGH:
+			return q ? (uint32_t)(q->desc_addr >> 32) : 0;
+		case VIRT_REG_QUEUEDRIVERLOW:
+			return q ? (uint32_t)(q->avail_addr & 0xFFFFFFFF) : 0;
+		case VIRT_REG_QUEUEDRIVERHIGH:
+			return q ? (uint32_t)(q->avail_addr >> 32) : 0;
+		case VIRT_REG_QUEUEDEVICELOW:
+			return q ? (uint32_t)(q->used_addr & 0xFFFFFFFF) : 0;
+		case VIRT_REG_QUEUEDEVICEHIGH:
+			return q ? (uint32_t)(q->used_addr >> 32) : 0;
+		case VIRT_REG_CONFIGGENERATION:
+			return config_generation;
+		case VIRT_REG_BALLOON_NUMPAGES:
+			return target_pages.load(std::memory_order_relaxed);
+		case VIRT_REG_BALLOON_ACTUAL:
+			return actual_pages;
+		default:
+			return 0;
+	}
+}
+
+void VirtIO_Balloon::write(uint64_t addr, MemorySize size, uint64_t val)
+{
+	uint64_t off = addr - start;
+	VirtQueueState* q = queue_sel < VIRTIO_BALLOON_QUEUES ? &queues[queue_sel] : nullptr;
+	switch(off)
+	{
+		case VIRT_REG_DEVICEFEATURESSEL:
+			device_features_sel = (uint32_t)val;
+			break;
+		case VIRT_REG_DRIVERFEATURESSEL:
+			driver_features_sel = (uint32_t)val;
+			break;
+		case VIRT_REG_DRIVERFEATURES:
+		{
+			if(driver_features_sel == 0)
+				driver_features = (driver_features & ~0xFFFFFFFFULL) | (uint64_t)(uint32_t)val;
+			else
+				driver_features = (driver_features & 0xFFFFFFFFULL) | ((uint64_t)(uint32_t)val << 32);
+			break;
+		}
+		case VIRT_REG_QUEUESEL:
+			queue_sel = (uint32_t)val;
+			break;
+		case VIRT_REG_QUEUENUM:
+			if(q) q->size = (uint32_t)val;
+			break;
+		case VIRT_REG_QUEUEREADY:
+			if(q) q->ready = (val != 0);
+			break;
+		case VIRT_REG_QUEUEDESCLOW:
+			if(q) q->desc_addr = (q->desc_addr & ~0xFFFFFFFFULL) | (uint64_t)(uint32_t)val;
+			break;
+		case VIRT_REG_QUEUEDESCHIGH:
+			if(q) q->desc_addr = (q->desc_addr & 0xFFFFFFFFULL) | ((uint64_t)(uint32_t)val << 32);
+			break;
+		case VIRT_REG_QUEUEDRIVERLOW:
+			if(q) q->avail_addr = (q->avail_addr & ~0xFFFFFFFFULL) | (uint64_t)(uint32_t)val;
+			break;
+		case VIRT_REG_QUEUEDRIVERHIGH:
+			if(q) q->avail_addr = (q->avail_addr & 0xFFFFFFFFULL) | ((uint64_t)(uint32_t)val << 32);
+			break;
+		case VIRT_REG_QUEUEDEVICELOW:
+			if(q) q->used_addr = (q->used_addr & ~0xFFFFFFFFULL) | (uint64_t)(uint32_t)val;
+			break;
+		case VIRT_REG_QUEUEDEVICEHIGH:
+			if(q) q->used_addr = (q->used_addr & 0xFFFFFFFFULL) | ((uint64_t)(uint32_t)val << 32);
+			break;
+		case VIRT_REG_QUEUENOTIFY:
+			process_queue((uint32_t)val);
+			break;
+		case VIRT_REG_INTERRUPTACK:
+			interrupt_status &= ~((uint32_t)val);
+			break;
+		case VIRT_REG_BALLOON_ACTUAL:
+			actual_pages = (uint32_t)val;
+			break;
+		case VIRT_REG_STATUS:
+			if(val == 0)
+			{
+				device_status	 = 0;
+				interrupt_status = 0;
+				driver_features	 = 0;
+				reset_queues();
+			}
+			else
+			{
+				device_status |= (uint32_t)val;
+
+				if(device_status & VIRT_STATUS_FEATURES_OK)
+				{
+					if((driver_features & ~device_features) != 0)
+						device_status &= ~VIRT_STATUS_FEATURES_OK;
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+void VirtIO_Balloon::raise_irq()
+{
+	plic->set_pending(irq_num, true);
+}
@@ -17,20 +17,26 @@ Copyright 2026 Spalishe
 
 #include "../include/elfparser.hpp"
 #include "../include/memory_map.hpp"
-#include <vector>
+#include "../include/utils/mapped_file.hpp"
+#include <algorithm>
 
 ELFParser::ELFParser(MemoryMap* mmap) : mmap(mmap) {
 
 										};
 
-bool ELFParser::parse(char* buffer, size_t size, uint64_t* entry_pc)
+bool ELFParser::parse(const char* buffer, size_t size, uint64_t* entry_pc)
 {
-	uint64_t offset;
+	size_t offset = 0;
 
+	if(size < sizeof(ELF_Header))
+	{
+		printf("[ELF] File is too small to be an elf!");
+		return false;
+	}
 	ELF_Header header = read_from_buffer<ELF_Header>(buffer, &offset);
 
 	uint32_t v32;
-	uint32_t v8;
+	uint8_t v8;
 	std::memcpy(&v32, header.e_ident.data(), sizeof(uint32_t));
 	if(v32 != ELF_MAGIC)
 	{
@@ -50,56 +56,74 @@ bool ELFParser::parse(char* buffer, size_t size, uint64_t* entry_pc)
 		return false;
 	}
 
-	if(entry_pc != NULL)
+	if(header.e_phoff + (uint64_t)header.e_phnum * sizeof(ELF_ProgramHeader) > size)
 	{
-		*entry_pc = header.e_entry;
+		printf("[ELF] Program headers are out of file!");
+		return false;
 	}
 
-	offset = header.e_phoff;
-	std::vector<ELF_ProgramHeader> pheaders;
-	std::vector<ELF_SectionHeader> sheaders;
-	for(int i = 0; i < header.e_phnum; i++)
-	{
-		pheaders.push_back(read_from_buffer<ELF_ProgramHeader>(buffer, &offset));
-	}
-	offset = header.e_shoff;
-	for(int i = 0; i < header.e_shnum; i++)
+	if(entry_pc != NULL)
 	{
-		sheaders.push_back(read_from_buffer<ELF_SectionHeader>(buffer, &offset));
+		*entry_pc = header.e_entry;
 	}
 
+	// Program headers are read right from the buffer, segments are copied straight into guest memory
+	offset = header.e_phoff;
 	for(int i = 0; i < header.e_phnum; i++)
 	{
-		auto& ph = pheaders[i];
+		ELF_ProgramHeader ph = read_from_buffer<ELF_ProgramHeader>(buffer, &offset);
 		if(ph.p_type != ELF_PT_LOAD)
 			continue;
 
+		if(ph.p_offset + ph.p_filesz > size || ph.p_filesz > ph.p_memsz)
+		{
+			printf("[ELF] Segment %d is out of file!", i);
+			return false;
+		}
+
 		if(ph.p_vaddr < 0x80000000) mmap->add_region(ph.p_vaddr, ph.p_memsz);
 		MemoryRegion* newreg = mmap->find_region(ph.p_vaddr);
-
-		memcpy(newreg->data + (ph.p_paddr - newreg->base_addr), buffer + ph.p_offset, ph.p_filesz);
-
-		memset(newreg->data + ph.p_filesz,
-			   0,
-			   ph.p_memsz - ph.p_filesz);
+		if(ph.p_paddr < newreg->base_addr || ph.p_paddr + ph.p_memsz > newreg->base_addr + newreg->size)
+		{
+			printf("[ELF] Segment %d does not fit into memory!", i);
+			return false;
+		}
+
+		uint8_t* dst = newreg->data + (ph.p_paddr - newreg->base_addr);
+		memcpy(dst, buffer + ph.p_offset, ph.p_filesz);
+		memset(dst + ph.p_filesz, 0, ph.p_memsz - ph.p_filesz);
+		mmap->mark_dirty(ph.p_paddr, ph.p_memsz);
 	}
 
 	return true;
 }
 
+uint64_t ELFParser::image_end(const char* buffer, size_t size)
+{
+	ELF_Header header;
+	if(size < sizeof(ELF_Header)) return 0;
+	std::memcpy(&header, buffer, sizeof(ELF_Header));
+	if(header.e_phoff + (uint64_t)header.e_phnum * sizeof(ELF_ProgramHeader) > size) return 0;
+
+	uint64_t end = 0;
+	for(int i = 0; i < header.e_phnum; i++)
+	{
+		ELF_ProgramHeader ph;
+		std::memcpy(&ph, buffer + header.e_phoff + i * sizeof(ELF_ProgramHeader), sizeof(ELF_ProgramHeader));
+		if(ph.p_type == ELF_PT_LOAD)
+			end = std::max(end, ph.p_paddr + ph.p_memsz);
+	}
+	return end;
+}
+
 bool ELFParser::parse(std::string file_path, uint64_t* entry_pc)
 {
-	std::ifstream file(file_path, std::ios::binary | std::ios::ate);
-	if(!file.is_open())
+	MappedFile file(file_path);
+	if(!file.valid())
 	{
 		// error
 		printf("[RISCV-EM] File loading error! %s\n", std::strerror(errno));
 		return false;
 	}
-
-	std::streamsize size = file.tellg();
-	file.seekg(0, std::ios::beg);
-	char* buffer = new char[size]{};
-	file.read(buffer, size);
-	return parse(buffer, size, entry_pc);
+	return parse(file.data, file.size, entry_pc);
 }
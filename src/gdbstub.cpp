@@ -449,16 +449,11 @@ void GDB_parsePacket(const char* buffer)
 					gdb_execth = thread([]()
 					{
           while (gdb_exec) {
-			  if(!gdb_cpu->gdb_single_step)
+			  auto it = find(gdb_bp.begin(), gdb_bp.end(), gdb_hart->pc);
+			  if(it != gdb_bp.end() || !gdb_cpu->step())
 			  {
-				  uint64_t pc = gdb_hart->pc;
-				  auto it	  = find(gdb_bp.begin(), gdb_bp.end(), gdb_hart->pc);
-				  if(it != gdb_bp.end())
-				  {
-					  gdb_exec = false;
-					  break;
-				  }
-				  gdb_cpu->gdb_single_step = true;
+				  gdb_exec = false;
+				  break;
 			  }
 		  }
           GDB_sendPacket(gdb_sigint ? "S02" : "S05");
@@ -468,7 +463,7 @@ void GDB_parsePacket(const char* buffer)
 					break;
 				}
 				case 's':
-					gdb_cpu->gdb_single_step = true;
+					gdb_cpu->step();
 					GDB_sendPacket("S05");
 					break;
 				default:
@@ -481,7 +476,7 @@ void GDB_parsePacket(const char* buffer)
 		{
 			gdb_isR = false;
 			std::cout << "[GDB] Killed by GDB stub" << std::endl;
-			gdb_cpu->state = MachineState::Off;
+			gdb_cpu->set_state(MachineState::Off);
 			return;
 		}
 		if(packet.starts_with("c"))
@@ -490,14 +485,10 @@ void GDB_parsePacket(const char* buffer)
 			gdb_execth = thread([]()
 			{
         while (gdb_exec) {
-          if (!gdb_cpu->gdb_single_step) {
-            uint64_t pc = gdb_hart->pc;
-            auto it = find(gdb_bp.begin(), gdb_bp.end(), gdb_hart->pc);
-            if (it != gdb_bp.end()) {
-              gdb_exec = false;
-              break;
-            }
-            gdb_cpu->gdb_single_step = true;
+          auto it = find(gdb_bp.begin(), gdb_bp.end(), gdb_hart->pc);
+          if (it != gdb_bp.end() || !gdb_cpu->step()) {
+            gdb_exec = false;
+            break;
           }
         }
         GDB_sendPacket(gdb_sigint ? "S02" : "S05");
@@ -507,7 +498,7 @@ void GDB_parsePacket(const char* buffer)
 		}
 		if(packet.starts_with("s"))
 		{
-			gdb_cpu->gdb_single_step = true;
+			gdb_cpu->step();
 			GDB_sendPacket("S05");
 			return;
 		}
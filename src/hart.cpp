@@ -32,22 +32,126 @@ void Hart::init(uint64_t dtb_pos_at_memory, uint64_t entry_pc)
 	status.fields.SXL = 2;
 	status.fields.UXL = 2;
 #ifdef USE_JIT
-	hctx.regs	 = GPR;
-	hctx.mmio	 = mmio;
-	hctx.ram	 = mmap->ram_direct->ptr(0x80000000);
-	hctx.memsize = mmap->ram_direct->size;
+	hctx.regs	  = GPR;
+	hctx.mmio	  = mmio;
+	hctx.ram	  = mmap->ram_direct->ptr(0x80000000);
+	hctx.memsize  = mmap->ram_direct->size;
+	hctx.dirty	  = mmap->dirty.words;
+	hctx.page_gen = reinterpret_cast<uint32_t*>(mmap->page_gen);
 #endif
 }
 
-uint32_t Hart::fetch(uint64_t inst_pc)
+MemoryReturn Hart::fetch(uint64_t inst_pc, uint32_t* inst)
 {
-	uint32_t val	 = 0;
-	MemoryReturn out = mmio->read(*this, inst_pc, MemorySize::Int, &val);
+	uint64_t paddr = inst_pc;
+	MemoryReturn out;
+	*inst = 0;
+	if(mmu.enabled(*this, AccessType::Execute))
+	{
+		out = mmu.translate(*this, inst_pc, AccessType::Execute, &paddr);
+		if(!out.is_success) return out;
 
-	if(!out.is_success)
-		trap(EXC_INST_ACCESS_FAULT, out.tval, false);
+		if((inst_pc & (PAGE_SIZE - 1)) == PAGE_SIZE - 2) [[unlikely]]
+		{
+			// Instruction may cross page boundary, fetch it by halves
+			uint16_t lo = 0, hi = 0;
+			out			= mmio->read_phys(*this, paddr, MemorySize::Short, &lo);
+			if(!out.is_success) return { false, EXC_INST_ACCESS_FAULT, inst_pc };
+			*inst = lo;
+			if((lo & 3) != 3) return out; // Compressed
+
+			out = mmu.translate(*this, inst_pc + 2, AccessType::Execute, &paddr);
+			if(!out.is_success) return out;
+			out = mmio->read_phys(*this, paddr, MemorySize::Short, &hi);
+			if(!out.is_success) return { false, EXC_INST_ACCESS_FAULT, inst_pc + 2 };
+			*inst |= (uint32_t)hi << 16;
+			return out;
+		}
+	}
 
-	return val;
+	out = mmio->read_phys(*this, paddr, MemorySize::Int, inst);
+	if(!out.is_success) return { false, EXC_INST_ACCESS_FAULT, inst_pc };
+	return out;
+}
+
+MemoryReturn Hart::fetch_decoded(uint64_t inst_pc, InstructionCache** cache)
+{
+	uint64_t paddr = inst_pc;
+	if(mmu.enabled(*this, AccessType::Execute))
+	{
+		MemoryReturn out = mmu.translate(*this, inst_pc, AccessType::Execute, &paddr);
+		if(!out.is_success) return out;
+	}
+	*cache = dcache->lookup(idec, mmap, paddr);
+	if(*cache != nullptr) [[likely]]
+		return { true, 0, 0 };
+
+	// Devices and instructions crossing page are decoded on every execution
+	uint32_t inst;
+	MemoryReturn out = fetch(inst_pc, &inst);
+	if(!out.is_success) return out;
+	if((inst & 3) != 3) inst &= 0xFFFF;
+	idec->decode_into(dcache->scratch, inst);
+	*cache = &dcache->scratch;
+	return out;
+}
+
+void Hart::fast_tlb_fill(uint64_t vaddr, AccessType type)
+{
+	uint64_t paddr = vaddr;
+	uint8_t perm   = FAST_TLB_R | FAST_TLB_W;
+	if(mmu.enabled(*this, type))
+	{
+		// Translation just succeeded, so this is TLB hit. Readable page is not necessarily writable (or clean)
+		if(!mmu.translate(*this, vaddr, type, &paddr).is_success) return;
+		if(type == AccessType::Read) perm = FAST_TLB_R;
+	}
+
+	MemoryRegion* ram = mmap->ram_direct;
+	uint64_t page	  = paddr & ~(PAGE_SIZE - 1);
+	if(page < ram->base_addr || page + PAGE_SIZE > ram->base_addr + ram->size)
+		return; // Devices always go through MMIO
+
+	FastTLBEntry& e = mmu.ftlb[MMU::fast_index(vaddr)];
+	if(e.vpn == (vaddr >> PAGE_SHIFT))
+	{
+		e.perm |= perm;
+		return;
+	}
+	e.vpn	  = vaddr >> PAGE_SHIFT;
+	e.host	  = ram->data + (page - ram->base_addr);
+	e.ppn_idx = (page - ram->base_addr) >> PAGE_SHIFT;
+	e.perm	  = perm;
+}
+
+MemoryReturn Hart::atomic_ptr(uint64_t vaddr, MemorySize size, AccessType type, uint8_t** host)
+{
+	if(vaddr & ((uint64_t)size - 1)) [[unlikely]]
+	{
+		char cause = type == AccessType::Read ? EXC_LOAD_ADDR_MISALIGNED : EXC_STORE_ADDR_MISALIGNED;
+		return { false, cause, vaddr };
+	}
+
+	uint8_t perm	= type == AccessType::Read ? FAST_TLB_R : FAST_TLB_W;
+	FastTLBEntry& e = mmu.ftlb[MMU::fast_index(vaddr)];
+	if(e.vpn != (vaddr >> PAGE_SHIFT) || !(e.perm & perm))
+	{
+		if(mmu.enabled(*this, type))
+		{
+			uint64_t paddr;
+			MemoryReturn out = mmu.translate(*this, vaddr, type, &paddr);
+			if(!out.is_success) return out;
+		}
+		fast_tlb_fill(vaddr, type);
+		if(e.vpn != (vaddr >> PAGE_SHIFT) || !(e.perm & perm))
+		{
+			// Device, caller goes through MMIO
+			*host = nullptr;
+			return { true, 0, 0 };
+		}
+	}
+	*host = e.host + (vaddr & (PAGE_SIZE - 1));
+	return { true, 0, 0 };
 }
 
 ExecReturn Hart::single_inst(InstructionCache& cache)
@@ -56,31 +160,83 @@ ExecReturn Hart::single_inst(InstructionCache& cache)
 	return out;
 }
 
+bool Hart::exec_block()
+{
+	uint64_t paddr = pc;
+	if(mmu.enabled(*this, AccessType::Execute))
+	{
+		// Faults are raised by regular fetch
+		if(!mmu.translate(*this, pc, AccessType::Execute, &paddr).is_success) return false;
+	}
+	CodeBlock* blk = bcache->lookup(idec, mmap, paddr);
+	if(blk == nullptr) return false;
+#ifdef USE_JIT
+	jctx->stopBlock();
+#endif
+
+	PredecodedOp* op					 = &bcache->ops[blk->first];
+	PredecodedOp* end					 = op + blk->count;
+	const std::atomic<uint32_t>& cur_gen = mmap->page_gen[blk->page];
+	uint32_t gen						 = blk->gen;
+	// Counters are published only where something may read them
+	uint64_t done = 0, synced = 0;
+	while(true)
+	{
+		if(op->sync) [[unlikely]]
+		{
+			retired += done - synced;
+			synced = done;
+		}
+		GPR[0]		   = 0;
+		ExecReturn out = op->func(*this, op->data);
+		if(!out.is_success) [[unlikely]]
+		{
+			retired += done - synced;
+			// Fused pair left everything as it was, single step path runs it again one instruction at a time
+			if(op->insts != 1)
+				return false;
+			stalled++;
+			trap(out.cause, out.tval, false);
+			return true;
+		}
+		done += op->insts;
+		pc += out.increase_pc;
+		// Taken branch, last op, or store into this very page
+		if(out.increase_pc != op->size || ++op == end || cur_gen.load(std::memory_order_relaxed) != gen)
+			break;
+	}
+	retired += done - synced;
+	return true;
+}
+
 void Hart::tick()
 {
 	GPR[0] = 0;
-	csrs[CSR_MCYCLE]++;
+	if(irq_changed.load(std::memory_order_relaxed)) [[unlikely]]
+		fold_irq();
 	if((ip.raw & ie.raw) != 0) [[unlikely]]
 		check_ints();
 	if(WFI) [[unlikely]]
 	{
 		// We must continue execution even if we has locally pending interruptions
 		if(int_local_pending()) WFI = false;
+		stalled++;
 
 		return;
 	}
 
 	uint64_t prevpc = pc;
 #ifdef USE_JIT
-	if(jctx->count != 0)
+	bool jit_ok = jit_usable();
+	if(jctx->count != 0 && jit_ok)
 	{
 		JIT_Function& jit_entry = jctx->jits[jit_index(pc)];
 
 		if(jit_entry.valid && jit_entry.pc == pc && last_jit_pc_exit != pc) [[unlikely]]
 		{
-			if(jit_entry.page_version != jctx->page_verion_bitmap[(pc - 0x80000000) >> 12]) [[unlikely]]
+			if(jit_entry.page_version != mmap->page_gen[(pc - 0x80000000) >> 12].load(std::memory_order_relaxed)) [[unlikely]]
 			{
-				jit_entry.valid = false;
+				jctx->invalidate(jit_entry);
 				for(auto* val : jctx->pc_hits)
 					delete val;
 				jctx->clear_pc_hits();
@@ -88,7 +244,16 @@ void Hart::tick()
 			}
 			hctx.exit_pc	= 0;
 			hctx.loop_count = 1000;
+			jit_running		= jit_entry.arena;
 			jit_entry.func(&hctx);
+			jit_running = nullptr;
+			// Compiled branches charge the block size against loop_count on every pass, a block left
+			// without them either ran through once or side-exited to interpreter, which counts the rest
+			int64_t charged = 1000 - (int64_t)hctx.loop_count;
+			if(charged > 0)
+				retired += charged;
+			else if(hctx.exit_pc == 0)
+				retired += jit_entry.inst_count;
 
 			if(hctx.exit_pc != 0)
 			{
@@ -102,15 +267,33 @@ void Hart::tick()
 		}
 	}
 	last_jit_pc_exit = 0;
+	// Cold code runs in blocks, once it gets hot it is profiled instruction by instruction for JIT
+	bool blocks_ok = block_interp && (!jit_ok || jctx->block_cold(pc));
+#else
+	bool blocks_ok = block_interp;
 #endif
-	uint32_t inst			= fetch(pc);
-	InstructionCache& cache = idec->decode_inst(pc, inst);
+	if(blocks_ok && exec_block())
+		return;
+
+	InstructionCache* decoded;
+	MemoryReturn fetched = fetch_decoded(pc, &decoded);
+	if(!fetched.is_success) [[unlikely]]
+	{
+#ifdef USE_JIT
+		jctx->stopBlock();
+#endif
+		stalled++;
+		trap(fetched.exc_code, fetched.tval, false);
+		return;
+	}
+	InstructionCache& cache = *decoded;
 	if(!cache.valid)
 	{
 #ifdef USE_JIT
 		jctx->stopBlock();
 #endif
-		trap(EXC_ILLEGAL_INSTRUCTION, inst, false);
+		stalled++;
+		trap(EXC_ILLEGAL_INSTRUCTION, cache.inst_raw, false);
 		return;
 	}
 
@@ -121,19 +304,56 @@ void Hart::tick()
 #ifdef USE_JIT
 		jctx->stopBlock();
 #endif
+		stalled++;
 		trap(out.cause, out.tval, false);
 		return;
 	}
 	else
 	{
-		csrs[CSR_MINSTRET]++;
+		retired++;
 		pc += out.increase_pc;
 	}
 #ifdef USE_JIT
-	jctx->handleInstruction(*this, cache, prevpc);
+	if(jit_ok)
+		jctx->handleInstruction(*this, cache, prevpc);
+	else
+		jctx->stopBlock();
 #endif
 }
 
+// Executes up to budget cycles, stops early on WFI, trap, deferred access or exit request. Returns cycles spent
+uint64_t Hart::run(uint64_t budget)
+{
+	uint64_t start = cycles();
+	trap_taken	   = false;
+	do
+	{
+		tick();
+		if(WFI || trap_taken || sync_pending || exit_request.load(std::memory_order_relaxed)) [[unlikely]]
+			break;
+	} while(cycles() - start < budget);
+	exit_request.store(false, std::memory_order_relaxed);
+	return cycles() - start;
+}
+
+void Hart::fold_irq()
+{
+	// Flag is cleared before lines are read, so change that comes in between is folded next time
+	irq_changed.exchange(false, std::memory_order_acq_rel);
+	uint16_t lines	 = irq_lines.load(std::memory_order_acquire);
+	uint16_t changed = (lines ^ irq_seen) & ~(1 << MIP_SEIP);
+	ip.raw			 = (ip.raw & ~changed) | (lines & changed);
+	irq_seen		 = lines;
+	update_seip();
+}
+
+void Hart::update_seip()
+{
+	// SEIP follows line level rather than edges, so software clear can't hide a line that is still high
+	bool seip = seip_sw || (irq_seen >> MIP_SEIP) & 1;
+	ip.raw	  = (ip.raw & ~(1ULL << MIP_SEIP)) | ((uint64_t)seip << MIP_SEIP);
+}
+
 bool Hart::int_local_pending()
 {
 	if((ip.raw & ie.raw) == 0)
@@ -205,7 +425,15 @@ bool Hart::check_ints()
 
 void Hart::trap(uint64_t cause, uint64_t tval, bool interrupt)
 {
+	if(cause == EXC_SYNC_DEFER && !interrupt) [[unlikely]]
+	{
+		// pc stays at the instruction
+		sync_pending = true;
+		return;
+	}
 	WFI						= false;
+	trap_taken				= true;
+	mmu.flush_fast();
 	uint64_t trap_pc		= pc;
 	PrivilegeMode prev_mode = mode;
 
@@ -254,25 +482,46 @@ void Hart::csr_write(uint16_t csr, uint64_t val)
 	{
 		case CSR_MSTATUS:
 			status.raw = (status.raw & MSTATUS_RO_MASK) | (val & ~MSTATUS_RO_MASK);
+			mmu.flush_fast(); // MPRV, MPP, SUM and MXR change translation
 			break;
 		case CSR_SSTATUS:
 			status.raw = (status.raw & ~SSTATUS_MASK) | (val & SSTATUS_MASK);
+			mmu.flush_fast();
 			break;
 		case CSR_SIE:
 			ie.raw = (ie.raw & ~SE_MASK) | (val & SE_MASK);
 			break;
 		case CSR_SIP:
-			ip.raw = (ip.raw & ~SE_MASK) | (val & SE_MASK);
+			// sip.SEIP is read-only
+			ip.raw = (ip.raw & ~SIP_WRITE_MASK) | (val & SIP_WRITE_MASK);
 			break;
 		case CSR_MIE:
 			ie.raw = val;
 			break;
 		case CSR_MIP:
-			ip.raw = val;
+			ip.raw	= (ip.raw & ~MIP_WRITE_MASK) | (val & MIP_WRITE_MASK);
+			seip_sw = (val >> MIP_SEIP) & 1;
+			update_seip();
 			break;
 		case CSR_STIMECMP:
 			timecmp_set(&stimecmp, val);
 			break;
+		case CSR_MCYCLE:
+			mcycle_base = val - cycles();
+			break;
+		case CSR_MINSTRET:
+			minstret_base = val - retired;
+			break;
+		case CSR_SATP:
+		{
+			// Writing unsupported mode has no effect at all
+			uint64_t satp_mode = SATP_MODE(val);
+			if(satp_mode != SATP_MODE_BARE && satp_mode != SATP_MODE_SV39 && satp_mode != SATP_MODE_SV48)
+				break;
+			csrs[CSR_SATP] = val;
+			mmu.flush_fast();
+			break;
+		}
 		case CSR_FCSR:
 		{
 			if(!status.fields.FS)
@@ -315,6 +564,12 @@ void Hart::csr_write(uint16_t csr, uint64_t val)
 			csrs[csr] = val;
 	}
 }
+uint64_t Hart::csr_read_rmw(uint16_t csr)
+{
+	if(csr == CSR_MIP)
+		return (ip.raw & ~(1ULL << MIP_SEIP)) | ((uint64_t)seip_sw << MIP_SEIP);
+	return csr_read(csr);
+}
 uint64_t Hart::csr_read(uint16_t csr)
 {
 	switch(csr)
@@ -332,9 +587,13 @@ uint64_t Hart::csr_read(uint16_t csr)
 		case CSR_MIE:
 			return ie.raw;
 		case CSR_CYCLE:
-			return csrs[CSR_MCYCLE];
+		case CSR_MCYCLE:
+			return mcycle_base + cycles();
 		case CSR_INSTRET:
-			return csrs[CSR_MINSTRET];
+		case CSR_MINSTRET:
+			return minstret_base + retired;
+		case CSR_TIME:
+			return mtime ? timer_get(mtime) : 0;
 		case CSR_HPMCOUNTER3 ... CSR_HPMCOUNTER31:
 			return csrs[csr - 0x100]; // get M versions
 		case CSR_STIMECMP:
@@ -22,9 +22,13 @@ Copyright 2026 Spalishe
 #include "../include/devices/plic.hpp"
 #include "../include/devices/syscon.hpp"
 #include "../include/devices/uart.hpp"
+#include "../include/devices/virtio_balloon.hpp"
 #include "../include/devices/virtio_blk.hpp"
+#include "../include/utils/mapped_file.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdio>
 #include <cstring>
@@ -34,7 +38,8 @@ Copyright 2026 Spalishe
 
 Machine::Machine(uint64_t mem_size, uint8_t hart_count) : memory_size(mem_size), harts_count(hart_count)
 {
-	// Init harts
+	// Init harts, storage is reserved up front so harts never move (JIT context and CLINT point at them)
+	harts.reserve(hart_count);
 	for(int i = 0; i < hart_count; i++)
 	{
 		harts.emplace_back(i, mem_size);
@@ -67,6 +72,12 @@ void Machine::init_fdt()
 		fdt_node_add_prop_str(chosen, "bootargs", append.c_str());
 	}
 	fdt_node_add_prop_str(chosen, "stdout-path", "/soc/uart@10000000"); // i suggest we have uart at all times
+	uint64_t initrd_start, initrd_end;
+	if(initrd_range(&initrd_start, &initrd_end))
+	{
+		fdt_node_add_prop_u64(chosen, "linux,initrd-start", initrd_start);
+		fdt_node_add_prop_u64(chosen, "linux,initrd-end", initrd_end);
+	}
 	fdt_node_add_child(fdt, chosen);
 
 	// memory
@@ -91,7 +102,7 @@ void Machine::init_fdt()
 		fdt_node_add_prop_u32(cpu, "riscv,cboz-block-size", 64);
 		fdt_node_add_prop_str(cpu, "compatible", "riscv");
 		fdt_node_add_prop_str(cpu, "riscv,isa", "rv64imafdc_zicsr_zifencei_zicboz_zba_zbb_zbc_zbs");
-		fdt_node_add_prop_str(cpu, "mmu-type", "riscv,none");
+		fdt_node_add_prop_str(cpu, "mmu-type", "riscv,sv48");
 		fdt_node_add_prop_str(cpu, "status", "okay");
 
 		fdt_node* intc = fdt_node_create("interrupt-controller");
@@ -119,6 +130,8 @@ void Machine::init_fdt()
 
 void Machine::write_fdt()
 {
+	// Preloaded memory brings its own FDT
+	if(ram_preload_file != nullptr) return;
 	if(dtb_file != nullptr)
 	{
 		load_fdt();
@@ -147,23 +160,117 @@ void Machine::load_fdt()
 {
 	uint64_t dtb_path_in_memory = 0x80000000 + memory_size - 0x20000;
 
-	fseek(dtb_file, 0, SEEK_END);
-	long size = ftell(dtb_file);
-	fseek(dtb_file, 0, SEEK_SET);
-	char* buffer = new char[size + 1];
-	fread(buffer, 1, size, dtb_file);
-	buffer[size] = '\0';
+	MappedFile file(dtb_file);
+	if(!file.valid())
+	{
+		printf("[RISCV-EM] FDT loading error! %s\n", std::strerror(errno));
+		return;
+	}
+	mmap->load_buffer(dtb_path_in_memory, file.data, file.size);
+}
+
+// End of single image loaded at base, ELF segments go to their own addresses
+static uint64_t image_end(FILE* file, uint64_t base)
+{
+	MappedFile image(file);
+	if(!image.valid()) return base;
+	if(image.size >= sizeof(uint32_t) && *(const uint32_t*)image.data == ELF_MAGIC)
+		return ELFParser::image_end(image.data, image.size);
+	return base + image.size;
+}
+
+uint64_t Machine::images_end()
+{
+	uint64_t end = image_end(bios_file, 0x80000000);
+	if(kernel_file != nullptr)
+		end = std::max(end, image_end(kernel_file, 0x80200000));
+	return end;
+}
+
+bool Machine::initrd_range(uint64_t* start, uint64_t* end)
+{
+	size_t size = MappedFile::size_of(initrd_file);
+	if(size == 0 || size + 0x20000 > memory_size) return false;
+	// Right below the FDT, page aligned
+	uint64_t dtb_path_in_memory = 0x80000000 + memory_size - 0x20000;
+	*start						= (dtb_path_in_memory - size) & ~0xFFFULL;
+	*end						= *start + size;
+	// Must not overlap bios or kernel
+	return *start >= images_end();
+}
+
+bool Machine::load_images(uint64_t* entry)
+{
+	// Preloaded memory already holds everything guest needs, copying files over it would clobber it
+	if(ram_preload_file != nullptr) return true;
+
+	// Files are mapped and copied straight into guest memory
+	MappedFile bios(bios_file);
+	if(!bios.valid())
+	{
+		printf("[RISCV-EM] Bios loading error! %s\n", std::strerror(errno));
+		return false;
+	}
+	if(!mmap->load_buffer(0x80000000, bios.data, bios.size, entry)) return false;
+
+	if(kernel_file != nullptr)
+	{
+		MappedFile kernel(kernel_file);
+		if(!kernel.valid())
+		{
+			printf("[RISCV-EM] Kernel loading error! %s\n", std::strerror(errno));
+			return false;
+		}
+		if(!mmap->load_buffer(0x80200000, kernel.data, kernel.size)) return false;
+	}
 
-	mmap->load_buffer(dtb_path_in_memory, buffer, size);
+	uint64_t initrd_start, initrd_end;
+	if(initrd_range(&initrd_start, &initrd_end))
+	{
+		MappedFile initrd(initrd_file);
+		if(!initrd.valid())
+		{
+			printf("[RISCV-EM] Initrd loading error! %s\n", std::strerror(errno));
+			return false;
+		}
+		// Raw copy, initrd may be anything
+		memcpy(mmap->ram_direct->ptr(initrd_start), initrd.data, initrd.size);
+		mmap->mark_dirty(initrd_start, initrd.size);
+	}
+	else if(initrd_file != nullptr)
+	{
+		printf("[RISCV-EM] Initrd is empty or does not fit into memory!\n");
+		return false;
+	}
+	return true;
 }
 
 void Machine::init_mmap()
 {
 	mmap = new MemoryMap();
-	mmap->add_region(0x80000000, memory_size);
+	mmap->add_region(0x80000000, memory_size, hugepages, ram_preload_file ? fileno(ram_preload_file) : -1);
+	if(hugepages && ram_preload_file)
+		printf("[RISCV-EM] DRAM is backed by preload file, huge pages are not used\n");
+	else if(hugepages)
+	{
+		switch(mmap->ram_direct->huge)
+		{
+			case HugePages::Huge1G:
+				printf("[RISCV-EM] DRAM is backed by 1G huge pages\n");
+				break;
+			case HugePages::Huge2M:
+				printf("[RISCV-EM] DRAM is backed by 2M huge pages\n");
+				break;
+			case HugePages::Transparent:
+				printf("[RISCV-EM] No hugetlb pages available, DRAM uses transparent huge pages\n");
+				break;
+			case HugePages::None:
+				printf("[RISCV-EM] Huge pages are not available, DRAM uses regular pages\n");
+				break;
+		}
+	}
 	mmio = new MMIO(mmap, memory_size);
-	idec = new InstructionDecoder();
-	idec->init_all_instrs();
+	idec = InstructionDecoder::shared();
 #ifdef USE_JIT
 	jidec = new JIT_InstructionDecoder();
 	jidec->init_all_instrs();
@@ -182,31 +289,34 @@ void Machine::init_auto_devices()
 	{
 		mmio->create_device_auto<VirtIO_BLK>(*this);
 	}
+	if(balloon)
+	{
+		auto dev = mmio->create_device_auto<VirtIO_Balloon>(*this);
+		dev->set_target(balloon_target >> 12);
+	}
+}
+
+bool Machine::use_blocks()
+{
+#ifdef USE_GDBSTUB
+	// GDB steps machine one instruction at a time
+	if(gdb) return false;
+#endif
+	return block_interp;
+}
+
+bool Machine::use_hart_threads()
+{
+#ifdef USE_GDBSTUB
+	// GDB steps every hart together from work thread
+	if(gdb) return false;
+#endif
+	return true;
 }
 
 void Machine::run()
 {
-	fseek(bios_file, 0, SEEK_END);
-	long size = ftell(bios_file);
-	fseek(bios_file, 0, SEEK_SET);
-	char* buffer = new char[size + 1];
-	fread(buffer, 1, size, bios_file);
-	buffer[size] = '\0';
-	bool out	 = mmap->load_buffer(0x80000000, buffer, size, &entry_pc);
-	delete[] buffer;
-	if(!out) return;
-	if(kernel_file != nullptr)
-	{
-		fseek(kernel_file, 0, SEEK_END);
-		long size = ftell(kernel_file);
-		fseek(kernel_file, 0, SEEK_SET);
-		char* buffer = new char[size + 1];
-		fread(buffer, 1, size, kernel_file);
-		buffer[size] = '\0';
-		out			 = mmap->load_buffer(0x80200000, buffer, size);
-		delete[] buffer;
-	}
-	if(!out) return;
+	if(!load_images(&entry_pc)) return;
 
 	uint64_t dtb_path_in_memory = 0x80000000 + memory_size - 0x20000;
 	// init all harts
@@ -217,8 +327,10 @@ void Machine::run()
 		h.mmio	= mmio;
 		h.idec	= idec;
 #ifdef USE_JIT
-		h.jidec = jidec;
+		h.jidec		  = jidec;
+		h.jit_enabled = !deterministic;
 #endif
+		h.block_interp = use_blocks();
 		h.init(dtb_path_in_memory, entry_pc);
 	}
 
@@ -229,11 +341,130 @@ void Machine::run()
 	state = MachineState::Running;
 #endif
 
+	start_harts();
 	// create work thread
 	work_thread	  = std::thread(&Machine::work, this);
 	work_thread_w = true;
 }
 
+void Machine::start_harts()
+{
+	if(!use_hart_threads()) return;
+	if(deterministic)
+	{
+		lockstep.emplace(harts_count, LockstepSync{ this });
+		lockstep_exit = false;
+		for(auto& h : harts)
+		{
+			h.quantum_left = quantum;
+			hart_threads.emplace_back(&Machine::hart_work_lockstep, this, std::ref(h));
+		}
+		return;
+	}
+	for(auto& h : harts)
+		hart_threads.emplace_back(&Machine::hart_work, this, std::ref(h));
+}
+
+void Machine::join_harts()
+{
+	for(auto& t : hart_threads)
+		t.join();
+	hart_threads.clear();
+	lockstep.reset();
+}
+
+void Machine::hart_work(Hart& h)
+{
+	std::shared_ptr<CLINT> clint = mmio->get<CLINT>();
+	MachineState s;
+	while((s = state.load(std::memory_order_acquire)) != MachineState::Off && s != MachineState::Resetting)
+	{
+		if(s == MachineState::Halted)
+		{
+			state.wait(MachineState::Halted, std::memory_order_acquire);
+			continue;
+		}
+
+		uint32_t bell = h.doorbell.load(std::memory_order_acquire);
+		h.run(quantum);
+		// Nothing to do in WFI until timer is due, or interrupt or state change rings the doorbell
+		if(h.WFI && state.load(std::memory_order_acquire) == MachineState::Running)
+		{
+			uint64_t delay = clint ? clint->next_timer_ns(h) : UINT64_MAX;
+			if(delay != 0) h.park(bell, delay);
+			// CLINT thread may not have noticed deadline yet
+			if(clint && clint->next_timer_ns(h) == 0)
+			{
+				std::lock_guard<std::mutex> guard(clint->lock);
+				clint->update_mip();
+			}
+		}
+	}
+}
+
+void Machine::hart_work_lockstep(Hart& h)
+{
+	while(!lockstep_exit)
+	{
+		// Parallel phase, whatever other harts could observe in different order is put off to serial phase
+		h.defer_shared = true;
+		while(h.quantum_left != 0 && !h.sync_pending)
+		{
+			h.quantum_left -= std::min(h.quantum_left, h.run(h.quantum_left));
+			// Idles for the rest of quantum, interrupts come only between quanta anyway
+			if(h.WFI) h.quantum_left = 0;
+		}
+		h.defer_shared = false;
+		lockstep->arrive_and_wait();
+	}
+}
+
+void Machine::serial_phase()
+{
+	// Deferred accesses run one after another in hart order
+	bool quantum_done = true;
+	for(auto& h : harts)
+	{
+		if(h.sync_pending)
+		{
+			// Only the deferred instruction runs here, a whole block would let the ones after it skip deferral
+			bool blocks	   = h.block_interp;
+			h.block_interp = false;
+			h.sync_pending = false;
+			h.quantum_left -= std::min(h.quantum_left, h.run(1));
+			h.block_interp = blocks;
+			if(h.WFI) h.quantum_left = 0;
+		}
+		if(h.quantum_left != 0) quantum_done = false;
+	}
+
+	if(quantum_done)
+	{
+		// Time moves and devices raise interrupts only between quanta
+		virtual_ns += quantum;
+		mmio->tick_all();
+		for(auto& h : harts)
+			h.quantum_left = quantum;
+	}
+
+	MachineState s = state.load(std::memory_order_acquire);
+	if(s == MachineState::Halted)
+	{
+		state.wait(MachineState::Halted, std::memory_order_acquire);
+		s = state.load(std::memory_order_acquire);
+	}
+	lockstep_exit = s == MachineState::Off || s == MachineState::Resetting;
+}
+
+bool Machine::on_machine_thread()
+{
+	std::thread::id self = std::this_thread::get_id();
+	if(work_thread_w && self == work_thread.get_id()) return true;
+	for(auto& t : hart_threads)
+		if(self == t.get_id()) return true;
+	return false;
+}
+
 void Machine::work()
 {
 	while(state.load(std::memory_order_acquire) != MachineState::Off)
@@ -242,33 +473,17 @@ void Machine::work()
 		{
 			// Total machine reset
 
+			join_harts();
 			destroy_harts();
 			reset_memory();
 
-			fseek(bios_file, 0, SEEK_END);
-			long size = ftell(bios_file);
-			fseek(bios_file, 0, SEEK_SET);
-			char* buffer = new char[size + 1];
-			fread(buffer, 1, size, bios_file);
-			buffer[size] = '\0';
-			mmap->load_buffer(0x80000000, buffer, size);
-			delete[] buffer;
-			if(kernel_file != nullptr)
-			{
-				fseek(kernel_file, 0, SEEK_END);
-				long size = ftell(kernel_file);
-				fseek(kernel_file, 0, SEEK_SET);
-				char* buffer = new char[size + 1];
-				fread(buffer, 1, size, kernel_file);
-				buffer[size] = '\0';
-				mmap->load_buffer(0x80200000, buffer, size);
-				delete[] buffer;
-			}
+			load_images();
 
 			write_fdt();
 
 			// Init harts
 			uint64_t dtb_path_in_memory = 0x80000000 + memory_size - 0x20000;
+			harts.reserve(harts_count);
 			for(int i = 0; i < harts_count; i++)
 			{
 				harts.emplace_back(i, memory_size);
@@ -277,63 +492,76 @@ void Machine::work()
 				hart.mmio  = mmio;
 				hart.idec  = idec;
 #ifdef USE_JIT
-				hart.jidec = jidec;
+				hart.jidec		 = jidec;
+				hart.jit_enabled = !deterministic;
 #endif
+				hart.block_interp = use_blocks();
 				hart.init(dtb_path_in_memory, entry_pc);
 			}
+			if(auto clint = mmio->get<CLINT>()) clint->attach_harts();
 // prepare
 #ifdef USE_GDBSTUB
 			state.store(gdb ? MachineState::Halted : MachineState::Running, std::memory_order_release);
 #else
 			state.store(MachineState::Running, std::memory_order_release);
 #endif
+			start_harts();
 			continue;
 		}
 
 		if(state.load(std::memory_order_acquire) == MachineState::Halted)
 		{
-#ifdef USE_GDBSTUB
-			if(gdb_single_step)
-			{
-				state = MachineState::Running;
-			}
-#endif
-			std::this_thread::yield();
+			// Nothing runs until resume(), step() or stop() changes state
+			state.wait(MachineState::Halted, std::memory_order_acquire);
 			continue;
 		}
 
-		// Update devices
-		dev_tick_time++;
-		if(dev_tick_time == 0x1000)
+		if(!hart_threads.empty())
 		{
-			dev_tick_time = 0;
-			mmio->tick_all();
+			// Harts run on their own threads, only devices are left here (deterministic machine ticks them from serial phase)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			if(!deterministic) mmio->tick_all();
+			continue;
 		}
-		// Update harts
+
+		// Update harts one after another, each gets its quantum unless it stops earlier
+		uint64_t budget = quantum;
+#ifdef USE_GDBSTUB
+		if(gdb_single_step) budget = 1;
+#endif
+		uint64_t ran = 0;
 		for(int i = 0; i < harts_count; i++)
 		{
 			Hart& h = harts[i];
-			h.tick();
+			ran		= std::max(ran, h.run(budget));
 		}
 
-#ifdef USE_GDBSTUB
-		if(gdb_single_step)
+		// Update devices
+		virtual_ns += ran;
+		dev_tick_time += ran;
+		if(dev_tick_time >= 0x1000)
 		{
-			gdb_single_step = false;
-			state			= MachineState::Halted;
+			dev_tick_time = 0;
+			mmio->tick_all();
 		}
+
+#ifdef USE_GDBSTUB
+		if(gdb_single_step.exchange(false, std::memory_order_acq_rel))
+			pause();
 #endif
 	}
+	join_harts();
 	work_thread_w = false;
 }
 
 void Machine::stop()
 {
-	// stop work thread if it exists
+	// Work thread may be running before work_thread_w is set, so state is switched anyway
+	set_state(MachineState::Off);
+	// stop work thread if it exists, it joins hart threads itself
 	if(work_thread_w)
 	{
-		state.store(MachineState::Off, std::memory_order_release);
-		if(!work_thread_joined && std::this_thread::get_id() != work_thread.get_id())
+		if(!work_thread_joined && !on_machine_thread())
 			work_thread.join();
 	}
 }
@@ -345,30 +573,13 @@ void Machine::reset()
 		destroy_harts();
 		reset_memory();
 
-		fseek(bios_file, 0, SEEK_END);
-		long size = ftell(bios_file);
-		fseek(bios_file, 0, SEEK_SET);
-		char* buffer = new char[size + 1];
-		fread(buffer, 1, size, bios_file);
-		buffer[size] = '\0';
-		mmap->load_buffer(0x80000000, buffer, size);
-		delete[] buffer;
-		if(kernel_file != nullptr)
-		{
-			fseek(kernel_file, 0, SEEK_END);
-			long size = ftell(kernel_file);
-			fseek(kernel_file, 0, SEEK_SET);
-			char* buffer = new char[size + 1];
-			fread(buffer, 1, size, kernel_file);
-			buffer[size] = '\0';
-			mmap->load_buffer(0x80200000, buffer, size);
-			delete[] buffer;
-		}
+		load_images();
 
 		write_fdt();
 
 		// Init harts
 		uint64_t dtb_path_in_memory = 0x80000000 + memory_size - 0x20000;
+		harts.reserve(harts_count);
 		for(int i = 0; i < harts_count; i++)
 		{
 			harts.emplace_back(i, memory_size);
@@ -377,10 +588,13 @@ void Machine::reset()
 			hart.mmio  = mmio;
 			hart.idec  = idec;
 #ifdef USE_JIT
-			hart.jidec = jidec;
+			hart.jidec		 = jidec;
+			hart.jit_enabled = !deterministic;
 #endif
+			hart.block_interp = use_blocks();
 			hart.init(dtb_path_in_memory, entry_pc);
 		}
+		if(auto clint = mmio->get<CLINT>()) clint->attach_harts();
 // prepare
 #ifdef USE_GDBSTUB
 		state.store(gdb ? MachineState::Halted : MachineState::Running, std::memory_order_release);
@@ -389,15 +603,100 @@ void Machine::reset()
 #endif
 	}
 	else
-		state.store(MachineState::Resetting, std::memory_order_release);
+	{
+		set_state(MachineState::Resetting);
+	}
+}
+
+void Machine::set_state(MachineState s)
+{
+	state.store(s, std::memory_order_release);
+	state.notify_all();
+	request_exit();
+}
+
+bool Machine::pause()
+{
+	MachineState expected = MachineState::Running;
+	if(!state.compare_exchange_strong(expected, MachineState::Halted, std::memory_order_acq_rel))
+		return false;
+	state.notify_all();
+	request_exit();
+	return true;
+}
+
+bool Machine::resume()
+{
+	MachineState expected = MachineState::Halted;
+	if(!state.compare_exchange_strong(expected, MachineState::Running, std::memory_order_acq_rel))
+		return false;
+	state.notify_all();
+	return true;
+}
+
+bool Machine::set_balloon_target(uint64_t bytes)
+{
+	auto dev = mmio->get<VirtIO_Balloon>();
+	if(!dev) return false;
+	dev->set_target(bytes >> 12);
+	return true;
+}
+
+#ifdef USE_GDBSTUB
+bool Machine::step()
+{
+	gdb_single_step.store(true, std::memory_order_release);
+	if(!resume())
+	{
+		gdb_single_step.store(false, std::memory_order_relaxed);
+		return false;
+	}
+	// Work thread pauses machine right after the instruction
+	state.wait(MachineState::Running, std::memory_order_acquire);
+	return state.load(std::memory_order_acquire) == MachineState::Halted;
+}
+#endif
+
+void Machine::request_exit()
+{
+	for(auto& h : harts)
+	{
+		h.exit_request.store(true, std::memory_order_relaxed);
+		h.ring();
+	}
 }
 
 void Machine::reset_memory()
 {
 	for(auto* reg : mmap->regions)
 	{
-		memset(reg->data, 0, reg->size);
+		reg->reset();
+	}
+	mmap->mark_dirty(0x80000000, memory_size);
+}
+
+void Machine::enable_dirty_log()
+{
+	mmap->enable_dirty_log();
+#ifdef USE_JIT
+	// Compiled stores have to be emitted again with marking
+	for(auto& h : harts)
+	{
+		h.hctx.dirty = mmap->dirty.words;
+		h.jctx->flush();
+	}
+#endif
+}
+void Machine::disable_dirty_log()
+{
+#ifdef USE_JIT
+	for(auto& h : harts)
+	{
+		h.hctx.dirty = nullptr;
+		h.jctx->flush();
 	}
+#endif
+	mmap->disable_dirty_log();
 }
 
 void Machine::destroy_harts()
@@ -407,7 +706,7 @@ void Machine::destroy_harts()
 void Machine::destroy_devices()
 {
 	// If you think this will not remove actual objects from heap - it will
-	mmio->devs.clear();
+	mmio->clear_devices();
 }
 void Machine::destroy_mmap()
 {
@@ -38,7 +38,6 @@ Copyright 2026 Spalishe
 
 /*
  *		   TODO:
- *			-MMU
  *			-PMP
  *			-SPMP
  *		    -JIT:
@@ -46,7 +45,6 @@ Copyright 2026 Spalishe
  *				- 2-Pass Branch tags
  *				- AUIPC
  *				- LUI
- *				- RVC
  *		    -Zawrs
  *		    -Zabha
  *		    -Zacas
@@ -123,6 +121,8 @@ int main(int argc, char* argv[])
 		= parser.add<arp::str>("--kernel", "File with Supervisor Level program", arp::norequired, arp::nopos);
 	auto image_var = parser.add<arp::str>("--image", "File with Image file that will put on VirtIO-BLK",
 										  arp::norequired, arp::nopos);
+	auto initrd_var
+		= parser.add<arp::str>("--initrd", "File with initial ramdisk for kernel", arp::norequired, arp::nopos);
 
 	auto dtb_var
 		= parser.add<arp::str>("--dtb", "Use specified FDT instead of auto-generated", arp::norequired, arp::nopos);
@@ -135,7 +135,19 @@ int main(int argc, char* argv[])
 	auto mem_var = parser.add<arp::str>("--memsize", "Set custom memory size (Default is 512 MB)", arp::norequired,
 										arp::nopos, "-M");
 	auto harts_var
-		= parser.add<arp::uint>("--harts", "Set custom harts count (Default is 1)", arp::norequired, arp::nopos, "-S");
+		= parser.add<arp::uint>("--harts", "Set custom harts count, each runs on its own host thread (Default is 1)", arp::norequired, arp::nopos, "-S");
+	auto quantum_var = parser.add<arp::uint>("--quantum", "Cycles hart runs between checks of machine state (Default is 4096)",
+											 arp::norequired, arp::nopos);
+	auto hugepages_var = parser.add<arp::def>("--hugepages", "Back guest memory with huge pages", arp::norequired, arp::nopos);
+	auto ram_preload_var = parser.add<arp::str>("--ram-preload", "File that seeds guest memory only (no hart or device state), shared copy-on-write",
+												arp::norequired, arp::nopos);
+	auto noblocks_var
+		= parser.add<arp::def>("--noblocks", "Interpret instruction by instruction instead of pre-decoded blocks", arp::norequired, arp::nopos);
+	auto balloon_var = parser.add<arp::def>("--balloon", "Adds VirtIO balloon device with free page reporting", arp::norequired, arp::nopos);
+	auto balloon_target_var = parser.add<arp::uint>("--balloon-target", "MiB of memory guest is asked to give back through balloon (implies --balloon)",
+													arp::norequired, arp::nopos);
+	auto deterministic_var
+		= parser.add<arp::def>("--deterministic", "Run harts in lockstep quanta with guest time, so runs are reproducible", arp::norequired, arp::nopos);
 #ifdef USE_FRAMEBUFFER
 	auto fb_var
 		= parser.add<arp::str>("--framebuffer", "Enables framebuffer with defined size (F.e. 640x480)", arp::norequired, arp::nopos, "-fb");
@@ -184,6 +196,17 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	uint64_t quantum = 0x1000;
+	if(quantum_var->defined())
+	{
+		quantum = quantum_var->val();
+		if(quantum == 0)
+		{
+			std::cerr << "Quantum must be at least 1 cycle." << std::endl;
+			return -1;
+		}
+	}
+
 	atexit(cleanup_terminal);
 	termios newt;
 	tcgetattr(STDIN_FILENO, &oldt);
@@ -191,7 +214,22 @@ int main(int argc, char* argv[])
 	newt.c_lflag &= ~(ICANON | ISIG | ECHO);
 	tcsetattr(STDIN_FILENO, TCSANOW, &newt);
 
-	Machine machine = Machine(memsize, harts);
+	Machine machine	  = Machine(memsize, harts);
+	machine.hugepages = hugepages_var->defined();
+	machine.balloon	  = balloon_var->defined() || balloon_target_var->defined();
+	if(balloon_target_var->defined()) machine.balloon_target = (uint64_t)balloon_target_var->val() << 20;
+	machine.block_interp = !noblocks_var->defined();
+	machine.quantum		 = quantum;
+	machine.deterministic = deterministic_var->defined();
+	if(ram_preload_var->defined())
+	{
+		machine.ram_preload_file = fopen(ram_preload_var->val().c_str(), "rb");
+		if(machine.ram_preload_file == nullptr)
+		{
+			std::cerr << "Cannot open RAM preload file '" << ram_preload_var->val() << "'." << std::endl;
+			return -1;
+		}
+	}
 	machine.init_mmap();
 
 	// machine.mmap->load_file(0x80000000, bios_var->val());
@@ -206,6 +244,10 @@ int main(int argc, char* argv[])
 	{
 		machine.image_file = fopen(image_var->val().c_str(), "r+b");
 	}
+	if(initrd_var->defined())
+	{
+		machine.initrd_file = fopen(initrd_var->val().c_str(), "rb");
+	}
 
 	if(dtb_var->defined())
 	{
@@ -17,38 +17,88 @@ Copyright 2026 Spalishe
 
 #include "../include/mmio.hpp"
 #include "../include/hart.hpp"
+#include <algorithm>
 
 MMIO::MMIO(MemoryMap* mmap, uint64_t mem_size) : mmap(mmap), memsize(mem_size) {};
+MMIO::~MMIO()
+{
+	clear_devices();
+}
+
+void MMIO::map_device(Device* dev)
+{
+	if(dev->size == 0) return;
+	uint64_t last = std::min<uint64_t>(dev->end, MMIO_TABLE_LIMIT);
+	for(uint64_t page = dev->start & ~((1ULL << MMIO_PAGE_SHIFT) - 1); page < last; page += 1ULL << MMIO_PAGE_SHIFT)
+	{
+		Device**& l2 = dispatch[page >> MMIO_L1_SHIFT];
+		if(!l2) l2 = new Device*[MMIO_L2_SIZE]{};
+		Device*& slot = l2[(page >> MMIO_PAGE_SHIFT) & (MMIO_L2_SIZE - 1)];
+		slot		  = (slot == nullptr) ? dev : MMIO_SHARED_PAGE;
+	}
+}
+void MMIO::clear_devices()
+{
+	for(auto*& l2 : dispatch)
+	{
+		delete[] l2;
+		l2 = nullptr;
+	}
+	devs.clear();
+}
 
 MemoryReturn MMIO::write(Hart& h, uint64_t vaddr, MemorySize size, uint64_t val)
+{
+	h.amo_check_reservation(vaddr);
+	if(!h.mmu.enabled(h, AccessType::Write))
+		return write_phys(h, vaddr, size, val);
+
+	if((vaddr & (PAGE_SIZE - 1)) + (uint64_t)size > PAGE_SIZE) [[unlikely]]
+	{
+		// Access crosses page boundary, translate every byte before touching memory
+		uint64_t paddrs[8];
+		for(int i = 0; i < (int)size; i++)
+		{
+			MemoryReturn out = h.mmu.translate(h, vaddr + i, AccessType::Write, &paddrs[i]);
+			if(!out.is_success) return out;
+		}
+		for(int i = 0; i < (int)size; i++)
+		{
+			MemoryReturn out = write_phys(h, paddrs[i], MemorySize::Byte, (val >> (i * 8)) & 0xFF);
+			if(!out.is_success) return { false, out.exc_code, vaddr };
+		}
+		return { true, 0, 0 };
+	}
+
+	uint64_t paddr;
+	MemoryReturn out = h.mmu.translate(h, vaddr, AccessType::Write, &paddr);
+	if(!out.is_success) return out;
+	out = write_phys(h, paddr, size, val);
+	if(!out.is_success) out.tval = vaddr;
+	return out;
+}
+MemoryReturn MMIO::write_phys(Hart& h, uint64_t paddr, MemorySize size, uint64_t val)
 {
 	uint64_t end = 0x80000000ULL + memsize;
-	if(vaddr >= 0x80000000ULL && (vaddr + (uint64_t)size) <= end) [[likely]] // We subtracting by size to exclude chance of buffer overflow
+	if(paddr >= 0x80000000ULL && (paddr + (uint64_t)size) <= end) [[likely]] // We subtracting by size to exclude chance of buffer overflow
 	{
 		// DRAM
-		h.amo_check_reservation(vaddr);
-		mmap->store(vaddr, (int)size * 8, val);
-#ifdef USE_JIT
-		h.jctx->page_verion_bitmap[(vaddr - 0x80000000) >> 12]++;
-#endif
+		mmap->store(paddr, (int)size * 8, val);
 		return { true, 0, 0 };
 	}
 	// Looking up for devices in this range
-	for(const auto& dev : devs)
+	if(Device* dev = find_device(paddr, size))
 	{
-		if(vaddr >= dev->start && vaddr < (dev->start + dev->size - (int)size))
-		{
-			// found a device
-			// mmap->store(vaddr, (int)size * 8, val); // unnecessary
-			h.amo_check_reservation(vaddr);
-			dev->write(vaddr, size, val);
-			return { true, 0, 0 };
-		}
+		if(h.defer_shared) [[unlikely]]
+			return { false, EXC_SYNC_DEFER, paddr };
+		std::lock_guard<std::mutex> guard(dev->lock);
+		dev->write(paddr, size, val);
+		return { true, 0, 0 };
 	}
 
 	// We hit none of the existing regions
-	// h.trap(EXC_STORE_ACCESS_FAULT, vaddr, false);
-	return { false, EXC_STORE_ACCESS_FAULT, vaddr };
+	// h.trap(EXC_STORE_ACCESS_FAULT, paddr, false);
+	return { false, EXC_STORE_ACCESS_FAULT, paddr };
 }
 inline uint64_t MMIO::read_dram_fast(uint64_t vaddr, MemorySize size)
 {
@@ -67,32 +117,60 @@ inline uint64_t MMIO::read_dram_fast(uint64_t vaddr, MemorySize size)
 	return 0;
 }
 MemoryReturn MMIO::read(Hart& h, uint64_t vaddr, MemorySize size, void* val)
+{
+	if(!h.mmu.enabled(h, AccessType::Read))
+		return read_phys(h, vaddr, size, val);
+
+	if((vaddr & (PAGE_SIZE - 1)) + (uint64_t)size > PAGE_SIZE) [[unlikely]]
+	{
+		// Access crosses page boundary, assemble it byte by byte
+		uint64_t res = 0;
+		for(int i = 0; i < (int)size; i++)
+		{
+			uint64_t paddr;
+			uint8_t byte;
+			MemoryReturn out = h.mmu.translate(h, vaddr + i, AccessType::Read, &paddr);
+			if(!out.is_success) return out;
+			out = read_phys(h, paddr, MemorySize::Byte, &byte);
+			if(!out.is_success) return { false, out.exc_code, vaddr };
+			res |= (uint64_t)byte << (i * 8);
+		}
+		memcpy(val, &res, (size_t)size);
+		return { true, 0, 0 };
+	}
+
+	uint64_t paddr;
+	MemoryReturn out = h.mmu.translate(h, vaddr, AccessType::Read, &paddr);
+	if(!out.is_success) return out;
+	out = read_phys(h, paddr, size, val);
+	if(!out.is_success) out.tval = vaddr;
+	return out;
+}
+MemoryReturn MMIO::read_phys(Hart& h, uint64_t paddr, MemorySize size, void* val)
 {
 	uint64_t out;
 
 	uint64_t end = 0x80000000ULL + memsize;
-	if(vaddr >= 0x80000000ULL && (vaddr + (uint64_t)size) <= end) [[likely]] // We subtracting by size to exclude chance of buffer overflow
+	if(paddr >= 0x80000000ULL && (paddr + (uint64_t)size) <= end) [[likely]] // We subtracting by size to exclude chance of buffer overflow
 	{
 		// DRAM
-		// out = mmap->load(vaddr, (int)size * 8);
-		out = read_dram_fast(vaddr, size);
+		// out = mmap->load(paddr, (int)size * 8);
+		out = read_dram_fast(paddr, size);
 		goto success;
 	}
 	// Looking up for devices in this range
-	for(const auto& dev : devs)
+	if(Device* dev = find_device(paddr, size))
 	{
-		if(vaddr >= dev->start && vaddr < (dev->start + dev->size - (int)size + 1))
-		{
-			// found a device
-			// out = mmap->load(vaddr, (int)size * 8); // unnecessary
-			out = dev->read(vaddr, size);
-			goto success;
-		}
+		if(h.defer_shared) [[unlikely]]
+			return { false, EXC_SYNC_DEFER, paddr };
+		std::lock_guard<std::mutex> guard(dev->lock);
+		out = dev->read(paddr, size);
+		goto success;
 	}
 
 	// We hit none of the existing regions
-	// h.trap(EXC_LOAD_ACCESS_FAULT, vaddr, false);
-	return { false, EXC_LOAD_ACCESS_FAULT, vaddr };
+	// h.trap(EXC_LOAD_ACCESS_FAULT, paddr, false);
+	return { false, EXC_LOAD_ACCESS_FAULT, paddr };
 
 success:
 	// write out to val
@@ -0,0 +1,199 @@
+/*
+Copyright 2026 Spalishe
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#include "../include/mmu.hpp"
+#include "../include/defines/csr.hpp"
+#include "../include/hart.hpp"
+
+static inline MemoryReturn page_fault(AccessType type, uint64_t vaddr)
+{
+	switch(type)
+	{
+		case AccessType::Read:
+			return { false, EXC_LOAD_PAGE_FAULT, vaddr };
+		case AccessType::Write:
+			return { false, EXC_STORE_PAGE_FAULT, vaddr };
+		case AccessType::Execute:
+			return { false, EXC_INST_PAGE_FAULT, vaddr };
+	}
+	return { false, EXC_LOAD_PAGE_FAULT, vaddr };
+}
+
+static inline MemoryReturn access_fault(AccessType type, uint64_t vaddr)
+{
+	switch(type)
+	{
+		case AccessType::Read:
+			return { false, EXC_LOAD_ACCESS_FAULT, vaddr };
+		case AccessType::Write:
+			return { false, EXC_STORE_ACCESS_FAULT, vaddr };
+		case AccessType::Execute:
+			return { false, EXC_INST_ACCESS_FAULT, vaddr };
+	}
+	return { false, EXC_LOAD_ACCESS_FAULT, vaddr };
+}
+
+bool MMU::check_perm(Hart& h, uint8_t flags, AccessType type)
+{
+	PrivilegeMode mode = effective_mode(h, type);
+	if(flags & PTE_U)
+	{
+		// S-mode can touch user pages only with SUM, and never execute them
+		if(mode == PrivilegeMode::Supervisor && (type == AccessType::Execute || !h.status.fields.SUM))
+			return false;
+	}
+	else if(mode == PrivilegeMode::User)
+		return false;
+
+	switch(type)
+	{
+		case AccessType::Read:
+			return (flags & PTE_R) || (h.status.fields.MXR && (flags & PTE_X));
+		case AccessType::Write:
+			return flags & PTE_W;
+		case AccessType::Execute:
+			return flags & PTE_X;
+	}
+	return false;
+}
+
+MemoryReturn MMU::walk(Hart& h, uint64_t vaddr, AccessType type, TLBEntry& out)
+{
+	uint64_t satp = h.csrs[CSR_SATP];
+	int levels	  = SATP_MODE(satp) == SATP_MODE_SV48 ? 4 : 3;
+	int va_bits	  = PAGE_SHIFT + levels * 9;
+
+	// Upper bits must be copies of the highest VA bit
+	if((uint64_t)(((int64_t)vaddr << (64 - va_bits)) >> (64 - va_bits)) != vaddr)
+		return page_fault(type, vaddr);
+
+	uint64_t table = (satp & SATP_PPN_MASK) << PAGE_SHIFT;
+	bool global	   = false;
+	for(int i = levels - 1; i >= 0; i--)
+	{
+		uint64_t pte_addr = table + ((vaddr >> (PAGE_SHIFT + i * 9)) & 0x1FF) * 8;
+		uint64_t pte;
+		if(!h.mmio->read_phys(h, pte_addr, MemorySize::Long, &pte).is_success)
+			return access_fault(type, vaddr);
+
+		if(!(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W)) || (pte & PTE_RESERVED))
+			return page_fault(type, vaddr);
+
+		global |= (pte & PTE_G) != 0;
+		uint64_t ppn = (pte >> PTE_PPN_SHIFT) & PTE_PPN_MASK;
+
+		if(!(pte & (PTE_R | PTE_X)))
+		{
+			// Pointer to next level, A/D/U are reserved here
+			if(pte & (PTE_A | PTE_D | PTE_U))
+				return page_fault(type, vaddr);
+			table = ppn << PAGE_SHIFT;
+			continue;
+		}
+
+		// Leaf
+		uint64_t super_mask = (1ULL << (i * 9)) - 1;
+		if(ppn & super_mask)
+			return page_fault(type, vaddr); // Misaligned superpage
+		if(!check_perm(h, pte, type))
+			return page_fault(type, vaddr);
+
+		// Hardware A/D update
+		uint64_t new_pte = pte | PTE_A | (type == AccessType::Write ? PTE_D : 0);
+		if(new_pte != pte)
+		{
+			if(!h.mmio->write_phys(h, pte_addr, MemorySize::Long, new_pte).is_success)
+				return access_fault(type, vaddr);
+		}
+
+		uint64_t vpn = vaddr >> PAGE_SHIFT;
+		out.vpn		 = vpn;
+		out.ppn		 = ppn | (vpn & super_mask);
+		out.asid	 = SATP_ASID(satp);
+		out.flags	 = new_pte & 0xFF;
+		out.level	 = i;
+		out.global	 = global;
+		out.valid	 = true;
+		return { true, 0, 0 };
+	}
+	return page_fault(type, vaddr);
+}
+
+MemoryReturn MMU::translate(Hart& h, uint64_t vaddr, AccessType type, uint64_t* paddr)
+{
+	uint64_t vpn = vaddr >> PAGE_SHIFT;
+	TLBEntry& e	 = tlb[tlb_index(vpn)];
+	if(e.valid && e.vpn == vpn && (e.global || e.asid == SATP_ASID(h.csrs[CSR_SATP]))) [[likely]]
+	{
+		// Store to a clean page must go through the walker to set D
+		if(check_perm(h, e.flags, type) && (type != AccessType::Write || (e.flags & PTE_D))) [[likely]]
+		{
+			*paddr = (e.ppn << PAGE_SHIFT) | (vaddr & (PAGE_SIZE - 1));
+			return { true, 0, 0 };
+		}
+	}
+
+	TLBEntry entry;
+	MemoryReturn out = walk(h, vaddr, type, entry);
+	if(!out.is_success) return out;
+	e	   = entry;
+	*paddr = (e.ppn << PAGE_SHIFT) | (vaddr & (PAGE_SIZE - 1));
+	return out;
+}
+
+void MMU::flush_fast()
+{
+	for(auto& e : ftlb)
+		e.vpn = ~0ULL;
+}
+
+void MMU::flush_all()
+{
+	for(auto& e : tlb)
+		e.valid = false;
+	flush_fast();
+}
+void MMU::flush_asid(uint16_t asid)
+{
+	for(auto& e : tlb)
+	{
+		if(e.valid && !e.global && e.asid == asid)
+			e.valid = false;
+	}
+	flush_fast();
+}
+void MMU::flush_vaddr(uint64_t vaddr)
+{
+	// Superpages are cached as 4K entries, so compare on the leaf level
+	uint64_t vpn = vaddr >> PAGE_SHIFT;
+	for(auto& e : tlb)
+	{
+		if(e.valid && (e.vpn >> (e.level * 9)) == (vpn >> (e.level * 9)))
+			e.valid = false;
+	}
+	flush_fast();
+}
+void MMU::flush_vaddr_asid(uint64_t vaddr, uint16_t asid)
+{
+	uint64_t vpn = vaddr >> PAGE_SHIFT;
+	for(auto& e : tlb)
+	{
+		if(e.valid && !e.global && e.asid == asid && (e.vpn >> (e.level * 9)) == (vpn >> (e.level * 9)))
+			e.valid = false;
+	}
+	flush_fast();
+}
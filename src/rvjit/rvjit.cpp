@@ -20,6 +20,7 @@ Copyright 2026 Spalishe
 #include "../../include/hart.hpp"
 #include "../../include/rvjit/rvjit_emit.hpp"
 #include "../../include/rvjit/rvjit_x86_64.hpp"
+#include <algorithm>
 #include <cassert>
 
 #define assert_msg(condition, format_str, ...)                              \
@@ -89,6 +90,7 @@ void JIT_Context::handleInstruction(Hart& h, InstructionCache& cache, uint64_t p
 				block.size	   = 0;
 				block.count	   = 0;
 				block.jmp_labels.clear();
+				block.fastmem_fixups.clear();
 
 				emitter.reset();
 				emitter.rvjit_emit_prologue(block);
@@ -128,9 +130,20 @@ end_block_gen:
 		// We built block sized enough. Go go gadget w^x allocations
 		JIT_Function func		  = arena.push_function(block.bytes, block.byte_pos);
 		func.inst_size			  = block.size;
+		func.inst_count			  = block.count;
 		func.pc					  = block.pc;
-		func.page_version		  = page_verion_bitmap[(block.pc - 0x80000000) >> 12];
-		jits[jit_index(block.pc)] = std::move(func);
+		func.page_version		  = h.mmap->page_gen[(block.pc - 0x80000000) >> 12].load(std::memory_order_relaxed);
+		if(func.valid)
+		{
+			uint64_t host = reinterpret_cast<uint64_t>(func.func);
+			func.arena	  = &arena;
+			for(auto& [access, slow] : block.fastmem_fixups)
+				arena.fixups.push_back({ host + access, host + slow });
+		}
+		JIT_Function& slot = jits[jit_index(block.pc)];
+		if(slot.valid)
+			invalidate(slot);
+		slot = std::move(func);
 		count++;
 
 		if(block.pc == 0x80377fb8)
@@ -140,6 +153,20 @@ end_block_gen:
 	}
 	hpage->set_ignore(pc);
 }
+bool JIT_Context::block_cold(uint64_t pc)
+{
+	// Block under construction is fed by single steps only
+	if(block_c) return false;
+	uint64_t page_idx = (pc - 0x80000000) >> 12;
+	if(pc < 0x80000000 || page_idx >= pc_hits.size()) return true;
+	if(!pc_hits[page_idx])
+	{
+		pc_hits[page_idx] = new HitPage{};
+	}
+	HitPage* hpage = pc_hits[page_idx];
+	if(hpage->is_ignore(pc)) return true;
+	return ++hpage->hits[(pc & 0xFFF) >> 1] <= RVJIT_PC_CAP;
+}
 void JIT_Context::stopBlock()
 {
 	if(block_c)
@@ -147,6 +174,28 @@ void JIT_Context::stopBlock()
 		block_c = false;
 	}
 }
+void JIT_Context::invalidate(JIT_Function& func)
+{
+	func.valid = false;
+	if(func.arena)
+	{
+		uint64_t start = reinterpret_cast<uint64_t>(func.func);
+		func.arena->drop_fixups(start, start + func.size);
+		func.arena = nullptr;
+	}
+}
+void JIT_Context::flush()
+{
+	stopBlock();
+	for(size_t i = 0; i < JIT_CACHE_SIZE; i++)
+	{
+		if(jits[i].valid)
+			invalidate(jits[i]);
+	}
+	for(auto* val : pc_hits)
+		delete val;
+	clear_pc_hits();
+}
 
 #include <sys/mman.h>
 #include <unistd.h>
@@ -229,5 +278,30 @@ JIT_Function JIT_Arena::push_function(const void* code, size_t code_size)
 	result.valid = true;
 	return result;
 }
+uint64_t JIT_Arena::find_fixup(uint64_t access) const
+{
+	// Plain binary search, nothing here may allocate or lock
+	const JIT_Fixup* lo = fixups.data();
+	size_t n			= fixups.size();
+	while(n > 0)
+	{
+		size_t half = n / 2;
+		if(lo[half].access < access)
+		{
+			lo += half + 1;
+			n -= half + 1;
+		}
+		else
+			n = half;
+	}
+	return (lo != fixups.data() + fixups.size() && lo->access == access) ? lo->slow : 0;
+}
+void JIT_Arena::drop_fixups(uint64_t start, uint64_t end)
+{
+	auto by_access = [](const JIT_Fixup& f, uint64_t addr) { return f.access < addr; };
+	auto first	   = std::lower_bound(fixups.begin(), fixups.end(), start, by_access);
+	auto last	   = std::lower_bound(first, fixups.end(), end, by_access);
+	fixups.erase(first, last);
+}
 
 #endif
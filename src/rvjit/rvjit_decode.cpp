@@ -24,17 +24,32 @@ JIT_InstructionCache JIT_InstructionDecoder::decode_inst(InstructionCache cache)
 	JIT_Instruction inst;
 	InstructionData data;
 	bool valid = false;
-	if(auto val = conversion_tbl.find(cache.inst->func); val != conversion_tbl.end())
+
+	const Instruction* dinst = cache.inst;
+	InstructionData idata	 = cache.data;
+	uint32_t raw			 = cache.inst_raw;
+	if(dinst->size == 2)
+	{
+		// Compressed instruction is compiled as its 32-bit form, block still advances by 2
+		raw = InstructionDecoder::expand_compressed(cache.inst_raw);
+		if(raw == 0) return { inst_raw, inst, data, valid };
+		dinst = InstructionDecoder::shared()->find_inst(raw);
+		if(dinst == nullptr) return { inst_raw, inst, data, valid };
+		idata = InstructionDecoder::decode_data(dinst, raw);
+	}
+
+	if(auto val = conversion_tbl.find(dinst->func); val != conversion_tbl.end())
 	{
 		valid	 = true;
-		inst	 = { val->second, cache.inst->imm_decode_func };
-		data	 = { cache.data.inst, cache.data.rs1, cache.data.rs2, cache.data.rd, cache.data.imm };
-		inst_raw = cache.inst_raw;
+		inst	 = { val->second, dinst->imm_decode_func };
+		data	 = { idata.inst, idata.rs1, idata.rs2, idata.rd, idata.imm };
+		inst_raw = raw;
 	}
 	return { inst_raw, inst, data, valid };
 }
 void JIT_InstructionDecoder::init_all_instrs()
 {
 	init_rv64i();
+	init_rv64m();
 }
 #endif
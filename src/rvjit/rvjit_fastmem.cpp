@@ -0,0 +1,71 @@
+/*
+Copyright 2026 Spalishe
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+*/
+
+#ifdef USE_JIT
+// Kept apart from rvjit_x86_64.hpp, ucontext register names clash with emitter ones
+#include "../../include/rvjit/rvjit.hpp"
+#include <cstdio>
+#include <signal.h>
+#include <ucontext.h>
+
+thread_local const JIT_Arena* jit_running = nullptr;
+
+static struct sigaction prev_action;
+
+static void fastmem_handler(int sig, siginfo_t* info, void* raw)
+{
+	ucontext_t* uc = (ucontext_t*)raw;
+	if(const JIT_Arena* arena = jit_running)
+	{
+		// Access hit guard page of the window: device, unmapped address or end of DRAM
+		if(uint64_t slow = arena->find_fixup(uc->uc_mcontext.gregs[REG_RIP]))
+		{
+			uc->uc_mcontext.gregs[REG_RIP] = slow;
+			return;
+		}
+	}
+
+	// Not ours, hand it to whoever was there before
+	if(prev_action.sa_flags & SA_SIGINFO)
+	{
+		prev_action.sa_sigaction(sig, info, raw);
+		return;
+	}
+	if(prev_action.sa_handler == SIG_IGN || prev_action.sa_handler == SIG_DFL)
+	{
+		// Fault will repeat on return and kill us as usual
+		signal(sig, SIG_DFL);
+		return;
+	}
+	prev_action.sa_handler(sig);
+}
+
+bool rvjit_fastmem_init()
+{
+	static int installed = -1;
+	if(installed != -1) return installed;
+
+	struct sigaction sa = {};
+	sa.sa_sigaction		= fastmem_handler;
+	sa.sa_flags			= SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	installed = sigaction(SIGSEGV, &sa, &prev_action) == 0;
+	if(!installed)
+		fprintf(stderr, "[RVJIT] Failed to install fastmem handler, memory accesses will be bounds checked.\n");
+	return installed;
+}
+#endif
@@ -42,6 +42,7 @@ ExecReturn exec_MRET(Hart& hart, InstructionData& inst)
 	hart.status.fields.MIE	= hart.status.fields.MPIE;
 	hart.status.fields.MPIE = 1;
 	hart.status.fields.MPP	= (char)PrivilegeMode::User;
+	hart.mmu.flush_fast();
 	return { true, true, 0, 0, 0 };
 }
 ExecReturn exec_SRET(Hart& hart, InstructionData& inst)
@@ -66,6 +67,7 @@ ExecReturn exec_SRET(Hart& hart, InstructionData& inst)
 	hart.status.fields.SIE	= hart.status.fields.SPIE;
 	hart.status.fields.SPIE = 1;
 	hart.status.fields.SPP	= (char)PrivilegeMode::User;
+	hart.mmu.flush_fast();
 	return { true, true, 0, 0, 0 };
 }
 ExecReturn exec_SFENCE_VMA(Hart& hart, InstructionData& inst)
@@ -83,7 +85,17 @@ ExecReturn exec_SFENCE_VMA(Hart& hart, InstructionData& inst)
 	{
 		return { false, false, 0, EXC_ILLEGAL_INSTRUCTION, inst.inst };
 	}
-	// tlb_flush(hart.mmio->mmu->tlb);
+	// rs1 selects virtual address, rs2 selects ASID, x0 means "all"
+	uint64_t vaddr = hart.GPR[inst.rs1];
+	uint16_t asid  = hart.GPR[inst.rs2] & 0xFFFF;
+	if(inst.rs1 == 0 && inst.rs2 == 0)
+		hart.mmu.flush_all();
+	else if(inst.rs1 == 0)
+		hart.mmu.flush_asid(asid);
+	else if(inst.rs2 == 0)
+		hart.mmu.flush_vaddr(vaddr);
+	else
+		hart.mmu.flush_vaddr_asid(vaddr, asid);
 	return { true, false, 4, 0, 0 };
 }
 ExecReturn exec_WFI(Hart& hart, InstructionData& inst)
@@ -96,22 +108,7 @@ ExecReturn exec_WFI(Hart& hart, InstructionData& inst)
 	}
 	if((hart.ip.raw & hart.ie.raw) == 0)
 	{
-		clock_t now = clock();
-
-		uint64_t offset;
-
-		/*if (hart.ie & (1U << IRQ_MTIMER)) {
-			offset = timecmp_delay_ns(&hart.aclint->mtimecmp[hart.id]);
-		}
-		if (hart.ie & (1U << IRQ_STIMER)) {
-			offset = min(UINT64_MAX,timecmp_delay_ns(&hart.stimecmp));
-		}
-
-		clock_t duration = (offset * CLOCKS_PER_SEC) / 1000000000LL;
-
-		//cout << timer_get(&hart.aclint->mtime) << "  " << timecmp_get(&hart.stimecmp) << "  " << offset << "   " << duration << endl;
-
-		hart.wfi_timer = now + duration;*/
+		// Hart thread sleeps on host until timer deadline or doorbell, see Machine::hart_work
 		hart.WFI = true;
 	}
 	return { true, false, 4, 0, 0 };
@@ -17,49 +17,200 @@ Copyright 2026 Spalishe
 
 #include "../../include/decode.hpp"
 #include "../../include/hart.hpp"
+#include <type_traits>
 
-MemoryReturn AMO_SC(Hart& hart, uint64_t va, MemorySize size, uint64_t val, void* out_val)
+enum class AmoOp
 {
-	if(hart.reservation.valid && hart.reservation.vaddr == va && hart.reservation.size == size)
+	Swap,
+	Add,
+	Xor,
+	And,
+	Or,
+	Min,
+	Max,
+	MinU,
+	MaxU
+};
+
+template <typename T>
+static inline T amo_apply(AmoOp op, T a, T b)
+{
+	using S = std::make_signed_t<T>;
+	switch(op)
 	{
-		MemoryReturn out = hart.mmio->write(hart, va, size, val);
-		if(!out.is_success) return out;
-		// amo_check_reservation(hart, va);
-		hart.reservation.valid = false;
-		*(uint8_t*)out_val	   = 0;
-		return out;
+		case AmoOp::Swap:
+			return b;
+		case AmoOp::Add:
+			return a + b;
+		case AmoOp::Xor:
+			return a ^ b;
+		case AmoOp::And:
+			return a & b;
+		case AmoOp::Or:
+			return a | b;
+		case AmoOp::Min:
+			return (T)std::min((S)a, (S)b);
+		case AmoOp::Max:
+			return (T)std::max((S)a, (S)b);
+		case AmoOp::MinU:
+			return std::min(a, b);
+		case AmoOp::MaxU:
+			return std::max(a, b);
 	}
-	else
+	return b;
+}
+
+// Locked host instruction where x86 has one, cmpxchg loop otherwise
+template <typename T>
+static inline T amo_host(AmoOp op, T* p, T b)
+{
+	switch(op)
 	{
-		hart.reservation.valid = false;
-		*(uint8_t*)out_val	   = 1;
-		return { true, 0, 0 };
+		case AmoOp::Swap:
+			return __atomic_exchange_n(p, b, __ATOMIC_SEQ_CST);
+		case AmoOp::Add:
+			return __atomic_fetch_add(p, b, __ATOMIC_SEQ_CST);
+		case AmoOp::Xor:
+			return __atomic_fetch_xor(p, b, __ATOMIC_SEQ_CST);
+		case AmoOp::And:
+			return __atomic_fetch_and(p, b, __ATOMIC_SEQ_CST);
+		case AmoOp::Or:
+			return __atomic_fetch_or(p, b, __ATOMIC_SEQ_CST);
+		default:
+		{
+			T cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+			while(!__atomic_compare_exchange_n(p, &cur, amo_apply(op, cur, b), true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+				;
+			return cur;
+		}
 	}
 }
-MemoryReturn AMO_LR(Hart& hart, uint64_t va, MemorySize size, void* val)
+
+// Loads and compare-exchanges value of LR/SC size through host pointer
+static inline uint64_t host_load(uint8_t* host, MemorySize size)
 {
-	uint64_t value;
-	MemoryReturn p = hart.mmio->read(hart, va, size, &value);
-	if(!p.is_success) return p;
-	hart.reservation.valid = true;
-	hart.reservation.size  = size;
-	hart.reservation.vaddr = va;
 	switch(size)
 	{
-		case MemorySize::Byte:
-			*(uint8_t*)val = value;
-			break;
-		case MemorySize::Short:
-			*(uint16_t*)val = value;
-			break;
 		case MemorySize::Int:
-			*(uint32_t*)val = value;
-			break;
+			return __atomic_load_n((uint32_t*)host, __ATOMIC_SEQ_CST);
 		case MemorySize::Long:
-			*(uint64_t*)val = value;
-			break;
+			return __atomic_load_n((uint64_t*)host, __ATOMIC_SEQ_CST);
+		default:
+			return 0;
+	}
+}
+static inline bool host_cmpxchg(uint8_t* host, MemorySize size, uint64_t expected, uint64_t val)
+{
+	switch(size)
+	{
+		case MemorySize::Int:
+		{
+			uint32_t exp = expected;
+			return __atomic_compare_exchange_n((uint32_t*)host, &exp, (uint32_t)val, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+		}
+		case MemorySize::Long:
+			return __atomic_compare_exchange_n((uint64_t*)host, &expected, val, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+		default:
+			return false;
 	}
-	return p;
+}
+
+MemoryReturn AMO_SC(Hart& hart, uint64_t va, MemorySize size, uint64_t val, uint64_t* out_val)
+{
+	if(hart.defer_shared) return { false, EXC_SYNC_DEFER, va };
+	Reservation& r = hart.reservation;
+	*out_val	   = 1;
+	if(!r.valid || r.vaddr != va || r.size != size)
+	{
+		r.valid = false;
+		return { true, 0, 0 };
+	}
+	r.valid = false;
+
+	uint8_t* host;
+	MemoryReturn out = hart.atomic_ptr(va, size, AccessType::Write, &host);
+	if(!out.is_success) return out;
+	if(host != r.host) return { true, 0, 0 }; // Mapping changed since LR
+
+	if(host)
+	{
+		// Line untouched by atomics of other harts and value still the same
+		std::atomic<uint32_t>& line = hart.mmap->resv_table[MemoryMap::resv_index(host)];
+		if(line.load(std::memory_order_acquire) != r.version || !host_cmpxchg(host, size, r.value, val))
+			return { true, 0, 0 };
+		line.fetch_add(1, std::memory_order_release);
+		hart.mmap->mark_dirty_host(host);
+		*out_val = 0;
+		return out;
+	}
+
+	std::lock_guard<std::mutex> guard(hart.mmap->amo_lock);
+	uint64_t cur = 0;
+	out			 = hart.mmio->read(hart, va, size, &cur);
+	if(!out.is_success) return out;
+	if(cur != r.value) return { true, 0, 0 };
+	out = hart.mmio->write(hart, va, size, val);
+	if(!out.is_success) return out;
+	*out_val = 0;
+	return out;
+}
+MemoryReturn AMO_LR(Hart& hart, uint64_t va, MemorySize size, uint64_t* val)
+{
+	if(hart.defer_shared) return { false, EXC_SYNC_DEFER, va };
+	uint8_t* host;
+	MemoryReturn out = hart.atomic_ptr(va, size, AccessType::Read, &host);
+	if(!out.is_success) return out;
+
+	uint64_t value	 = 0;
+	uint32_t version = 0;
+	if(host)
+	{
+		version = hart.mmap->resv_table[MemoryMap::resv_index(host)].load(std::memory_order_acquire);
+		value	= host_load(host, size);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> guard(hart.mmap->amo_lock);
+		out = hart.mmio->read(hart, va, size, &value);
+		if(!out.is_success) return out;
+	}
+	hart.reservation.valid	 = true;
+	hart.reservation.size	 = size;
+	hart.reservation.vaddr	 = va;
+	hart.reservation.value	 = value;
+	hart.reservation.host	 = host;
+	hart.reservation.version = version;
+	*val					 = value;
+	return out;
+}
+
+template <typename T>
+MemoryReturn AMO(Hart& hart, uint64_t va, T rs2, AmoOp op, T* out_val)
+{
+	// Order of atomics between harts is decided in serial phase of deterministic SMP
+	if(hart.defer_shared) return { false, EXC_SYNC_DEFER, va };
+	constexpr MemorySize size = (MemorySize)sizeof(T);
+	uint8_t* host;
+	MemoryReturn out = hart.atomic_ptr(va, size, AccessType::Write, &host);
+	if(!out.is_success) return out;
+
+	if(host) [[likely]]
+	{
+		*out_val = amo_host(op, (T*)host, rs2);
+		hart.mmap->resv_table[MemoryMap::resv_index(host)].fetch_add(1, std::memory_order_release);
+		hart.mmap->mark_dirty_host(host);
+		return out;
+	}
+
+	// Devices have no host memory, read-modify-write is done under lock
+	std::lock_guard<std::mutex> guard(hart.mmap->amo_lock);
+	T val;
+	out = hart.mmio->read(hart, va, size, &val);
+	if(!out.is_success) return out;
+	out = hart.mmio->write(hart, va, size, amo_apply(op, val, rs2));
+	if(!out.is_success) return out;
+	*out_val = val;
+	return out;
 }
 
 ExecReturn exec_LR_D(Hart& hart, InstructionData& inst)
@@ -79,88 +230,66 @@ ExecReturn exec_SC_D(Hart& hart, InstructionData& inst)
 	return { true, false, 4, 0, 0 };
 }
 
-MemoryReturn AMO64(Hart& hart, uint64_t va, uint64_t rs2, uint64_t (*func)(uint64_t a, uint64_t b), uint64_t* out_val)
-{
-	uint64_t val;
-	MemoryReturn out = hart.mmio->read(hart, va, MemorySize::Long, &val);
-	if(!out.is_success) return out;
-	uint64_t new_val = func(val, rs2);
-
-	MemoryReturn s = hart.mmio->write(hart, va, MemorySize::Long, new_val);
-	if(!s.is_success) return s;
-	*(uint64_t*)out_val = val;
-	return { true, 0, 0 };
-}
-
 ExecReturn exec_AMOSWAP_D(Hart& hart, InstructionData& inst)
 {
 	uint64_t val;
-	MemoryReturn out = AMO64(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], [](uint64_t a, uint64_t b)
-							 { return b; }, &val);
+	MemoryReturn out = AMO<uint64_t>(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], AmoOp::Swap, &val);
 	if(out.is_success) hart.GPR[inst.rd] = val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOADD_D(Hart& hart, InstructionData& inst)
 {
 	uint64_t val;
-	MemoryReturn out = AMO64(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], [](uint64_t a, uint64_t b)
-							 { return a + b; }, &val);
+	MemoryReturn out = AMO<uint64_t>(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], AmoOp::Add, &val);
 	if(out.is_success) hart.GPR[inst.rd] = val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOXOR_D(Hart& hart, InstructionData& inst)
 {
 	uint64_t val;
-	MemoryReturn out = AMO64(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], [](uint64_t a, uint64_t b)
-							 { return a ^ b; }, &val);
+	MemoryReturn out = AMO<uint64_t>(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], AmoOp::Xor, &val);
 	if(out.is_success) hart.GPR[inst.rd] = val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOAND_D(Hart& hart, InstructionData& inst)
 {
 	uint64_t val;
-	MemoryReturn out = AMO64(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], [](uint64_t a, uint64_t b)
-							 { return a & b; }, &val);
+	MemoryReturn out = AMO<uint64_t>(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], AmoOp::And, &val);
 	if(out.is_success) hart.GPR[inst.rd] = val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOOR_D(Hart& hart, InstructionData& inst)
 {
 	uint64_t val;
-	MemoryReturn out = AMO64(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], [](uint64_t a, uint64_t b)
-							 { return a | b; }, &val);
+	MemoryReturn out = AMO<uint64_t>(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], AmoOp::Or, &val);
 	if(out.is_success) hart.GPR[inst.rd] = val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOMIN_D(Hart& hart, InstructionData& inst)
 {
 	uint64_t val;
-	MemoryReturn out = AMO64(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], [](uint64_t a, uint64_t b)
-							 { return (uint64_t)std::min((int64_t)a, (int64_t)b); }, &val);
+	MemoryReturn out = AMO<uint64_t>(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], AmoOp::Min, &val);
 	if(out.is_success) hart.GPR[inst.rd] = val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOMAX_D(Hart& hart, InstructionData& inst)
 {
 	uint64_t val;
-	MemoryReturn out = AMO64(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], [](uint64_t a, uint64_t b)
-							 { return (uint64_t)std::max((int64_t)a, (int64_t)b); }, &val);
+	MemoryReturn out = AMO<uint64_t>(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], AmoOp::Max, &val);
 	if(out.is_success) hart.GPR[inst.rd] = val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOMINU_D(Hart& hart, InstructionData& inst)
 {
 	uint64_t val;
-	MemoryReturn out = AMO64(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], [](uint64_t a, uint64_t b)
-							 { return std::min(a, b); }, &val);
+	MemoryReturn out = AMO<uint64_t>(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], AmoOp::MinU, &val);
 	if(out.is_success) hart.GPR[inst.rd] = val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOMAXU_D(Hart& hart, InstructionData& inst)
 {
 	uint64_t val;
-	MemoryReturn out = AMO64(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], [](uint64_t a, uint64_t b)
-							 { return std::max(a, b); }, &val);
+	MemoryReturn out = AMO<uint64_t>(hart, hart.GPR[inst.rs1], hart.GPR[inst.rs2], AmoOp::MaxU, &val);
 	if(out.is_success) hart.GPR[inst.rd] = val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
@@ -169,7 +298,7 @@ ExecReturn exec_AMOMAXU_D(Hart& hart, InstructionData& inst)
 
 ExecReturn exec_LR_W(Hart& hart, InstructionData& inst)
 {
-	uint32_t val;
+	uint64_t val;
 	MemoryReturn out = AMO_LR(hart, hart.GPR[inst.rs1], MemorySize::Int, &val);
 	if(!out.is_success) return { false, false, 0, out.exc_code, out.tval };
 	hart.GPR[inst.rd] = (int64_t)(int32_t)val;
@@ -177,95 +306,73 @@ ExecReturn exec_LR_W(Hart& hart, InstructionData& inst)
 }
 ExecReturn exec_SC_W(Hart& hart, InstructionData& inst)
 {
-	uint32_t val;
+	uint64_t val;
 	MemoryReturn out = AMO_SC(hart, hart.GPR[inst.rs1], MemorySize::Int, (uint32_t)hart.GPR[inst.rs2], &val);
 	if(!out.is_success) return { false, false, 0, out.exc_code, out.tval };
 	hart.GPR[inst.rd] = val;
 	return { true, false, 4, 0, 0 };
 }
 
-MemoryReturn AMO32(Hart& hart, uint64_t va, uint32_t rs2, uint32_t (*func)(uint32_t a, uint32_t b), uint32_t* out_val)
-{
-	uint32_t val;
-	MemoryReturn out = hart.mmio->read(hart, va, MemorySize::Int, &val);
-	if(!out.is_success) return out;
-	uint64_t new_val = func(val, rs2);
-
-	MemoryReturn s = hart.mmio->write(hart, va, MemorySize::Int, new_val);
-	if(!s.is_success) return s;
-	*(uint32_t*)out_val = val;
-	return { true, 0, 0 };
-}
-
 ExecReturn exec_AMOSWAP_W(Hart& hart, InstructionData& inst)
 {
 	uint32_t val;
-	MemoryReturn out = AMO32(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], [](uint32_t a, uint32_t b)
-							 { return b; }, &val);
+	MemoryReturn out = AMO<uint32_t>(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], AmoOp::Swap, &val);
 	if(out.is_success) hart.GPR[inst.rd] = (int64_t)(int32_t)val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOADD_W(Hart& hart, InstructionData& inst)
 {
 	uint32_t val;
-	MemoryReturn out = AMO32(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], [](uint32_t a, uint32_t b)
-							 { return a + b; }, &val);
+	MemoryReturn out = AMO<uint32_t>(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], AmoOp::Add, &val);
 	if(out.is_success) hart.GPR[inst.rd] = (int64_t)(int32_t)val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOXOR_W(Hart& hart, InstructionData& inst)
 {
 	uint32_t val;
-	MemoryReturn out = AMO32(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], [](uint32_t a, uint32_t b)
-							 { return a ^ b; }, &val);
+	MemoryReturn out = AMO<uint32_t>(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], AmoOp::Xor, &val);
 	if(out.is_success) hart.GPR[inst.rd] = (int64_t)(int32_t)val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOAND_W(Hart& hart, InstructionData& inst)
 {
 	uint32_t val;
-	MemoryReturn out = AMO32(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], [](uint32_t a, uint32_t b)
-							 { return a & b; }, &val);
+	MemoryReturn out = AMO<uint32_t>(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], AmoOp::And, &val);
 	if(out.is_success) hart.GPR[inst.rd] = (int64_t)(int32_t)val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOOR_W(Hart& hart, InstructionData& inst)
 {
 	uint32_t val;
-	MemoryReturn out = AMO32(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], [](uint32_t a, uint32_t b)
-							 { return a | b; }, &val);
+	MemoryReturn out = AMO<uint32_t>(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], AmoOp::Or, &val);
 	if(out.is_success) hart.GPR[inst.rd] = (int64_t)(int32_t)val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOMIN_W(Hart& hart, InstructionData& inst)
 {
 	uint32_t val;
-	MemoryReturn out = AMO32(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], [](uint32_t a, uint32_t b)
-							 { return (uint32_t)std::min((int32_t)a, (int32_t)b); }, &val);
+	MemoryReturn out = AMO<uint32_t>(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], AmoOp::Min, &val);
 	if(out.is_success) hart.GPR[inst.rd] = (int64_t)(int32_t)val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOMAX_W(Hart& hart, InstructionData& inst)
 {
 	uint32_t val;
-	MemoryReturn out = AMO32(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], [](uint32_t a, uint32_t b)
-							 { return (uint32_t)std::max((int32_t)a, (int32_t)b); }, &val);
+	MemoryReturn out = AMO<uint32_t>(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], AmoOp::Max, &val);
 	if(out.is_success) hart.GPR[inst.rd] = (int64_t)(int32_t)val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOMINU_W(Hart& hart, InstructionData& inst)
 {
 	uint32_t val;
-	MemoryReturn out = AMO32(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], [](uint32_t a, uint32_t b)
-							 { return std::min(a, b); }, &val);
+	MemoryReturn out = AMO<uint32_t>(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], AmoOp::MinU, &val);
 	if(out.is_success) hart.GPR[inst.rd] = (int64_t)(int32_t)val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
 ExecReturn exec_AMOMAXU_W(Hart& hart, InstructionData& inst)
 {
 	uint32_t val;
-	MemoryReturn out = AMO32(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], [](uint32_t a, uint32_t b)
-							 { return std::max(a, b); }, &val);
+	MemoryReturn out = AMO<uint32_t>(hart, hart.GPR[inst.rs1], (uint32_t)hart.GPR[inst.rs2], AmoOp::MaxU, &val);
 	if(out.is_success) hart.GPR[inst.rd] = (int64_t)(int32_t)val;
 	return { out.is_success, false, 4, out.exc_code, out.tval };
 }
@@ -73,7 +73,7 @@ ExecReturn exec_LD(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr = hart.GPR[inst.rs1] + (int64_t)inst.imm;
 	uint64_t val;
-	MemoryReturn success = hart.mmio->read(hart, addr, MemorySize::Long, &val);
+	MemoryReturn success = hart.load(addr, &val);
 
 	if(success.is_success)
 	{
@@ -92,7 +92,7 @@ ExecReturn exec_LWU(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr = hart.GPR[inst.rs1] + (int64_t)inst.imm;
 	uint32_t val;
-	MemoryReturn success = hart.mmio->read(hart, addr, MemorySize::Int, &val);
+	MemoryReturn success = hart.load(addr, &val);
 
 	if(success.is_success)
 	{
@@ -111,7 +111,7 @@ ExecReturn exec_LWU(Hart& hart, InstructionData& inst)
 ExecReturn exec_SD(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr	 = hart.GPR[inst.rs1] + (int64_t)inst.imm;
-	MemoryReturn out = hart.mmio->write(hart, addr, MemorySize::Long, hart.GPR[inst.rs2]);
+	MemoryReturn out = hart.store<uint64_t>(addr, hart.GPR[inst.rs2]);
 	return {
 		out.is_success,
 		false,
@@ -226,7 +226,7 @@ ExecReturn exec_LB(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr = hart.GPR[inst.rs1] + (int64_t)inst.imm;
 	int8_t val;
-	MemoryReturn success = hart.mmio->read(hart, addr, MemorySize::Byte, &val);
+	MemoryReturn success = hart.load(addr, &val);
 	if(success.is_success)
 	{
 		hart.GPR[inst.rd] = (uint64_t)val;
@@ -243,7 +243,7 @@ ExecReturn exec_LH(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr = hart.GPR[inst.rs1] + (int64_t)inst.imm;
 	int16_t val;
-	MemoryReturn success = hart.mmio->read(hart, addr, MemorySize::Short, &val);
+	MemoryReturn success = hart.load(addr, &val);
 	if(success.is_success)
 	{
 		hart.GPR[inst.rd] = (uint64_t)val;
@@ -260,7 +260,7 @@ ExecReturn exec_LW(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr = hart.GPR[inst.rs1] + (int64_t)inst.imm;
 	int32_t val;
-	MemoryReturn success = hart.mmio->read(hart, addr, MemorySize::Int, &val);
+	MemoryReturn success = hart.load(addr, &val);
 	if(success.is_success)
 	{
 		hart.GPR[inst.rd] = (uint64_t)val;
@@ -277,7 +277,7 @@ ExecReturn exec_LBU(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr = hart.GPR[inst.rs1] + (int64_t)inst.imm;
 	uint8_t val;
-	MemoryReturn success = hart.mmio->read(hart, addr, MemorySize::Byte, &val);
+	MemoryReturn success = hart.load(addr, &val);
 	if(success.is_success)
 	{
 		hart.GPR[inst.rd] = (uint64_t)(uint8_t)val;
@@ -294,7 +294,7 @@ ExecReturn exec_LHU(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr = hart.GPR[inst.rs1] + (int64_t)inst.imm;
 	uint16_t val;
-	MemoryReturn success = hart.mmio->read(hart, addr, MemorySize::Short, &val);
+	MemoryReturn success = hart.load(addr, &val);
 
 	if(success.is_success)
 	{
@@ -313,7 +313,7 @@ ExecReturn exec_LHU(Hart& hart, InstructionData& inst)
 ExecReturn exec_SB(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr	 = hart.GPR[inst.rs1] + (int64_t)inst.imm;
-	MemoryReturn out = hart.mmio->write(hart, addr, MemorySize::Byte, hart.GPR[inst.rs2]);
+	MemoryReturn out = hart.store<uint8_t>(addr, hart.GPR[inst.rs2]);
 	return {
 		out.is_success,
 		false,
@@ -325,7 +325,7 @@ ExecReturn exec_SB(Hart& hart, InstructionData& inst)
 ExecReturn exec_SH(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr	 = hart.GPR[inst.rs1] + (int64_t)inst.imm;
-	MemoryReturn out = hart.mmio->write(hart, addr, MemorySize::Short, hart.GPR[inst.rs2]);
+	MemoryReturn out = hart.store<uint16_t>(addr, hart.GPR[inst.rs2]);
 	return {
 		out.is_success,
 		false,
@@ -337,7 +337,7 @@ ExecReturn exec_SH(Hart& hart, InstructionData& inst)
 ExecReturn exec_SW(Hart& hart, InstructionData& inst)
 {
 	uint64_t addr	 = hart.GPR[inst.rs1] + (int64_t)inst.imm;
-	MemoryReturn out = hart.mmio->write(hart, addr, MemorySize::Int, hart.GPR[inst.rs2]);
+	MemoryReturn out = hart.store<uint32_t>(addr, hart.GPR[inst.rs2]);
 	return {
 		out.is_success,
 		false,
@@ -1064,14 +1064,11 @@ uint64_t jit_slow_lb(Hart* h, uint64_t addr)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Byte))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Byte + 1))
-		{
-			// found a device
-			int8_t out = dev->read(addr, MemorySize::Byte);
-			return (uint64_t)out;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		int8_t out = dev->read(addr, MemorySize::Byte);
+		return (uint64_t)out;
 	}
 	return 0;
 }
@@ -1079,14 +1076,11 @@ uint64_t jit_slow_lbu(Hart* h, uint64_t addr)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Byte))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Byte + 1))
-		{
-			// found a device
-			uint8_t out = dev->read(addr, MemorySize::Byte);
-			return (uint64_t)out;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		uint8_t out = dev->read(addr, MemorySize::Byte);
+		return (uint64_t)out;
 	}
 	return 0;
 }
@@ -1094,14 +1088,11 @@ uint64_t jit_slow_lh(Hart* h, uint64_t addr)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Short))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Short + 1))
-		{
-			// found a device
-			int16_t out = dev->read(addr, MemorySize::Short);
-			return (uint64_t)out;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		int16_t out = dev->read(addr, MemorySize::Short);
+		return (uint64_t)out;
 	}
 	return 0;
 }
@@ -1109,14 +1100,11 @@ uint64_t jit_slow_lhu(Hart* h, uint64_t addr)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Short))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Short + 1))
-		{
-			// found a device
-			uint16_t out = dev->read(addr, MemorySize::Short);
-			return (uint64_t)out;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		uint16_t out = dev->read(addr, MemorySize::Short);
+		return (uint64_t)out;
 	}
 	return 0;
 }
@@ -1124,14 +1112,11 @@ uint64_t jit_slow_lw(Hart* h, uint64_t addr)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Int))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Int + 1))
-		{
-			// found a device
-			int32_t out = dev->read(addr, MemorySize::Int);
-			return (uint64_t)out;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		int32_t out = dev->read(addr, MemorySize::Int);
+		return (uint64_t)out;
 	}
 	return 0;
 }
@@ -1139,14 +1124,11 @@ uint64_t jit_slow_lwu(Hart* h, uint64_t addr)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Int))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Int + 1))
-		{
-			// found a device
-			uint32_t out = dev->read(addr, MemorySize::Int);
-			return (uint64_t)out;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		uint32_t out = dev->read(addr, MemorySize::Int);
+		return (uint64_t)out;
 	}
 	return 0;
 }
@@ -1154,14 +1136,11 @@ uint64_t jit_slow_ld(Hart* h, uint64_t addr)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Long))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Long + 1))
-		{
-			// found a device
-			uint64_t out = dev->read(addr, MemorySize::Long);
-			return out;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		uint64_t out = dev->read(addr, MemorySize::Long);
+		return out;
 	}
 	return 0;
 }
@@ -1171,23 +1150,92 @@ struct jit_memory_op
 {
 	void* fast_mov;
 	void* slow_find;
+	bool fastmem; // Bounds are enforced by guard pages instead of compare
+	bool dirty;	  // Stores mark pages in dirty bitmap
+	uint8_t size;
 };
 
+// Records store at RCX: bumps write generation of pages under it and marks them in dirty bitmap while logging is on.
+// page_bias makes RCX >> 12 index pages from start of DRAM
+static void jit_mark_store(JIT_Emitter& em, JIT_Block& blk, int32_t page_bias, uint8_t size, bool dirty)
+{
+	push(blk, REG_RAX);
+	push(blk, REG_RDX);
+	mov(blk, REG_RDX, REG_RCX);
+	add_r64imm8(blk, REG_RDX, size - 1);
+	shr_rimm8(blk, REG_RCX, 12);
+	shr_rimm8(blk, REG_RDX, 12);
+	mov_rm(blk, REG_RAX, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, page_gen));
+	lock_inc_m32(blk, REG_RAX, REG_RCX, 2, page_bias * 4);
+	if(dirty)
+	{
+		mov_rm(blk, REG_RAX, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, dirty));
+		lock_bts_mr(blk, REG_RCX, REG_RAX, page_bias / 8);
+	}
+
+	// Misaligned store may spill into next page
+	cmp(blk, REG_RCX, REG_RDX);
+	blk.jmp_labels.push_back({ "mark_end", blk.byte_pos, false, 1 });
+	je8(blk, 0);
+	mov_rm(blk, REG_RAX, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, page_gen));
+	lock_inc_m32(blk, REG_RAX, REG_RDX, 2, page_bias * 4);
+	if(dirty)
+	{
+		mov_rm(blk, REG_RAX, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, dirty));
+		lock_bts_mr(blk, REG_RDX, REG_RAX, page_bias / 8);
+	}
+	em.realize_label(blk, "mark_end");
+
+	pop(blk, REG_RDX);
+	pop(blk, REG_RAX);
+}
+
+// Adds imm to RCX in 64 bits and branches to "slow_path" when the sum doesn't fit in the 4G fastmem window
+static void jit_fastmem_offset(JIT_Block& blk, int32_t imm)
+{
+	add_rimm32(blk, REG_RCX, imm);
+	push(blk, REG_RCX);
+	shr_rimm8(blk, REG_RCX, 32);
+	pop(blk, REG_RCX); // POP keeps flags of SHR
+	blk.jmp_labels.push_back({ "slow_path", blk.byte_pos, false, 1 });
+	jne8(blk, 0);
+}
+
 bool jit_load(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter, void* func, void* func_slow)
 {
-	jit_memory_op stru = jit_memory_op{ func, func_slow };
+	jit_memory_op stru = jit_memory_op{ func, func_slow, hart.mmap->fastmem != nullptr && hart.jctx->fastmem, false, 0 };
 	emitter.inst_emit_i_type(hart, inst, blk, false, [](JIT_Emitter& em, JIT_Block& blk, VReg& rd, VReg& rs1, uint64_t imm, uint64_t pc, void* tmp)
 	{
+		auto function_data = *reinterpret_cast<jit_memory_op*>(tmp);
+		auto function_ptr  = reinterpret_cast<MovSignature>(function_data.fast_mov);
+
 		mov(blk, REG_RCX, rs1.host_reg);
-		add_rimm32(blk, REG_RCX, imm);
-		sub_rimm32(blk, REG_RCX, 0x40000000); //
-		sub_rimm32(blk, REG_RCX, 0x40000000); // This does sum of 0x80000000, which is beyond the int32_t limit
-		cmp_rm(blk, REG_RCX, REG_R12, NO_INDEX, 0, 24);
+		if(function_data.fastmem)
+		{
+			// R14 points 2G into the window
+			jit_fastmem_offset(blk, imm);
+			uint16_t access = blk.byte_pos;
+			function_ptr(blk, rd.host_reg, REG_R14, REG_RCX, 0, INT32_MIN);
+			blk.jmp_labels.push_back({ "end", blk.byte_pos, false, 1 });
+			jmp8(blk, 0);
+
+			// Fault handler lands here, slow path wants offset from DRAM start
+			blk.fastmem_fixups.push_back({ access, blk.byte_pos });
+			em.realize_label(blk, "slow_path");
+			sub_rimm32(blk, REG_RCX, 0x40000000);
+			sub_rimm32(blk, REG_RCX, 0x40000000);
+		}
+		else
+		{
+			add_rimm32(blk, REG_RCX, imm);
+			sub_rimm32(blk, REG_RCX, 0x40000000); //
+			sub_rimm32(blk, REG_RCX, 0x40000000); // This does sum of 0x80000000, which is beyond the int32_t limit
+			cmp_rm(blk, REG_RCX, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, memsize));
 
-		blk.jmp_labels.push_back({ "fast_path", blk.byte_pos, false, 1 });
-		jbe8(blk, 0);
+			blk.jmp_labels.push_back({ "fast_path", blk.byte_pos, false, 1 });
+			jbe8(blk, 0);
+		}
 
-		auto function_data = *reinterpret_cast<jit_memory_op*>(tmp);
 		{
 			// Slow path, make interpreter work instead
 			/*mov_imm64(blk, REG_RCX, pc);
@@ -1224,15 +1272,16 @@ bool jit_load(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& em
 			pop(blk, REG_RDX);
 			pop(blk, REG_RAX);*/
 			mov(blk, rd.host_reg, REG_RCX);
+		}
 
+		if(!function_data.fastmem)
+		{
 			blk.jmp_labels.push_back({ "end", blk.byte_pos, false, 1 });
 			jmp8(blk, 0);
-		}
 
-		em.realize_label(blk, "fast_path");
-
-		auto function_ptr = reinterpret_cast<MovSignature>(function_data.fast_mov);
-		function_ptr(blk, rd.host_reg, REG_R14, REG_RCX, 0, 0);
+			em.realize_label(blk, "fast_path");
+			function_ptr(blk, rd.host_reg, REG_R14, REG_RCX, 0, 0);
+		}
 		em.realize_label(blk, "end");
 	}, blk.pc + blk.size, reinterpret_cast<void*>(&stru));
 	return false;
@@ -1269,14 +1318,11 @@ void jit_slow_sb(Hart* h, uint64_t addr, uint64_t val)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Byte))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Byte + 1))
-		{
-			// found a device
-			dev->write(addr, MemorySize::Byte, val);
-			return;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		dev->write(addr, MemorySize::Byte, val);
+		return;
 	}
 }
 
@@ -1284,14 +1330,11 @@ void jit_slow_sh(Hart* h, uint64_t addr, uint64_t val)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Short))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Short + 1))
-		{
-			// found a device
-			dev->write(addr, MemorySize::Short, val);
-			return;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		dev->write(addr, MemorySize::Short, val);
+		return;
 	}
 }
 
@@ -1299,14 +1342,11 @@ void jit_slow_sw(Hart* h, uint64_t addr, uint64_t val)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Int))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Int + 1))
-		{
-			// found a device
-			dev->write(addr, MemorySize::Int, val);
-			return;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		dev->write(addr, MemorySize::Int, val);
+		return;
 	}
 }
 
@@ -1314,31 +1354,58 @@ void jit_slow_sd(Hart* h, uint64_t addr, uint64_t val)
 {
 	// We only know about phys addr
 	addr += 0x80000000;
-	for(const auto& dev : h->mmio->devs)
+	if(Device* dev = h->mmio->find_device(addr, MemorySize::Long))
 	{
-		if(addr >= dev->start && addr < (dev->start + dev->size - (int)MemorySize::Long + 1))
-		{
-			// found a device
-			dev->write(addr, MemorySize::Long, val);
-			return;
-		}
+		std::lock_guard<std::mutex> guard(dev->lock);
+		dev->write(addr, MemorySize::Long, val);
+		return;
 	}
 }
-bool jit_store(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter, void* func, void* func_slow)
+bool jit_store(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter, void* func, void* func_slow, uint8_t size)
 {
-	jit_memory_op stru = jit_memory_op{ func, func_slow };
+	jit_memory_op stru = jit_memory_op{ func, func_slow, hart.mmap->fastmem != nullptr && hart.jctx->fastmem, hart.hctx.dirty != nullptr, size };
 	emitter.inst_emit_s_type(hart, inst, blk, [](JIT_Emitter& em, JIT_Block& blk, VReg& rs1, VReg& rs2, uint64_t imm, uint64_t pc, void* tmp)
 	{
+		auto function_data = *reinterpret_cast<jit_memory_op*>(tmp);
+		auto function_ptr  = reinterpret_cast<MovSignature>(function_data.fast_mov);
+
 		mov(blk, REG_RCX, rs1.host_reg);
-		add_rimm32(blk, REG_RCX, (int32_t)imm);
-		sub_rimm32(blk, REG_RCX, 0x40000000); //
-		sub_rimm32(blk, REG_RCX, 0x40000000); // This does sum of 0x80000000, which is beyond the int32_t limit
-		cmp_rm(blk, REG_RCX, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, memsize));
+		if(function_data.fastmem)
+		{
+			// R14 points 2G into the window
+			jit_fastmem_offset(blk, (int32_t)imm);
+			if(rs2.vreg == 0)
+			{
+				push(blk, REG_RAX);
+				xor_rr(blk, REG_RAX, REG_RAX);
+			}
+			uint16_t access = blk.byte_pos;
+			function_ptr(blk, rs2.vreg == 0 ? REG_RAX : rs2.host_reg, REG_R14, REG_RCX, 0, INT32_MIN);
+			if(rs2.vreg == 0)
+				pop(blk, REG_RAX);
+			jit_mark_store(em, blk, -(0x80000000 >> 12), function_data.size, function_data.dirty); // RCX holds physical address here
+			blk.jmp_labels.push_back({ "end", blk.byte_pos, false, 1 });
+			jmp8(blk, 0);
+
+			// Fault handler lands here, slow path wants offset from DRAM start
+			blk.fastmem_fixups.push_back({ access, blk.byte_pos });
+			if(rs2.vreg == 0)
+				pop(blk, REG_RAX);
+			em.realize_label(blk, "slow_path");
+			sub_rimm32(blk, REG_RCX, 0x40000000);
+			sub_rimm32(blk, REG_RCX, 0x40000000);
+		}
+		else
+		{
+			add_rimm32(blk, REG_RCX, (int32_t)imm);
+			sub_rimm32(blk, REG_RCX, 0x40000000); //
+			sub_rimm32(blk, REG_RCX, 0x40000000); // This does sum of 0x80000000, which is beyond the int32_t limit
+			cmp_rm(blk, REG_RCX, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, memsize));
 
-		blk.jmp_labels.push_back({ "fast_path", blk.byte_pos, false, 1 });
-		jbe8(blk, 0);
+			blk.jmp_labels.push_back({ "fast_path", blk.byte_pos, false, 1 });
+			jbe8(blk, 0);
+		}
 
-		auto function_data = *reinterpret_cast<jit_memory_op*>(tmp);
 		{
 			// Slow path, make interpreter work instead
 			/*mov_imm64(blk, REG_RCX, pc);
@@ -1383,51 +1450,52 @@ bool jit_store(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& e
 			pop(blk, REG_RAX);
 			pop(blk, REG_RSI);
 			pop(blk, REG_RDI);
-			blk.jmp_labels.push_back({ "end", blk.byte_pos, false, 1 });
-			jmp8(blk, 0);
 		}
 
-		em.realize_label(blk, "fast_path");
-
-		auto function_ptr = reinterpret_cast<MovSignature>(function_data.fast_mov);
-
-		if(rs2.vreg == 0)
+		if(!function_data.fastmem)
 		{
-			push(blk, REG_RAX);
-			xor_rr(blk, REG_RAX, REG_RAX);
-			function_ptr(blk, REG_RAX, REG_R14, REG_RCX, 0, 0);
-			pop(blk, REG_RAX);
-		}
-		else
-			function_ptr(blk, rs2.host_reg, REG_R14, REG_RCX, 0, 0);
+			blk.jmp_labels.push_back({ "end", blk.byte_pos, false, 1 });
+			jmp8(blk, 0);
 
+			em.realize_label(blk, "fast_path");
+			if(rs2.vreg == 0)
+			{
+				push(blk, REG_RAX);
+				xor_rr(blk, REG_RAX, REG_RAX);
+				function_ptr(blk, REG_RAX, REG_R14, REG_RCX, 0, 0);
+				pop(blk, REG_RAX);
+			}
+			else
+				function_ptr(blk, rs2.host_reg, REG_R14, REG_RCX, 0, 0);
+			jit_mark_store(em, blk, 0, function_data.size, function_data.dirty);
+		}
 		em.realize_label(blk, "end");
 	}, blk.pc + blk.size, reinterpret_cast<void*>(&stru));
 	return false;
 }
 bool execjit_SB(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
 {
-	return jit_store(hart, inst, blk, emitter, reinterpret_cast<void*>(&mov_m8r8), reinterpret_cast<void*>(&jit_slow_sb));
+	return jit_store(hart, inst, blk, emitter, reinterpret_cast<void*>(&mov_m8r8), reinterpret_cast<void*>(&jit_slow_sb), 1);
 }
 bool execjit_SH(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
 {
-	return jit_store(hart, inst, blk, emitter, reinterpret_cast<void*>(&mov_m16r16), reinterpret_cast<void*>(&jit_slow_sh));
+	return jit_store(hart, inst, blk, emitter, reinterpret_cast<void*>(&mov_m16r16), reinterpret_cast<void*>(&jit_slow_sh), 2);
 }
 bool execjit_SW(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
 {
-	return jit_store(hart, inst, blk, emitter, reinterpret_cast<void*>(&mov_m32r32), reinterpret_cast<void*>(&jit_slow_sw));
+	return jit_store(hart, inst, blk, emitter, reinterpret_cast<void*>(&mov_m32r32), reinterpret_cast<void*>(&jit_slow_sw), 4);
 }
 bool execjit_SD(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
 {
-	return jit_store(hart, inst, blk, emitter, reinterpret_cast<void*>(&mov_mr), reinterpret_cast<void*>(&jit_slow_sd));
+	return jit_store(hart, inst, blk, emitter, reinterpret_cast<void*>(&mov_mr), reinterpret_cast<void*>(&jit_slow_sd), 8);
 }
 
 bool jit_branch(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter, void* func)
 {
 	emitter.inst_emit_b_type(hart, inst, blk, [](JIT_Emitter& em, JIT_Block& blk, VReg& rs1, VReg& rs2, uint64_t imm, uint64_t pc, void* tmp)
 	{
-		// Check for loop
-		sub_mimm32(blk, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, loop_count), blk.count);
+		// Check for loop, charges whole pass including this instruction (blk.count is bumped after emit)
+		sub_mimm32(blk, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, loop_count), blk.count + 1);
 		blk.jmp_labels.push_back({ "slow_path",
 								   blk.byte_pos,
 								   false,
@@ -1505,8 +1573,8 @@ bool execjit_JAL(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter&
 		mov_imm64(blk, rd.host_reg, pc);
 		add_r64imm8(blk, rd.host_reg, 4);
 
-		// Check for loop
-		sub_mimm32(blk, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, loop_count), blk.count);
+		// Check for loop, charges whole pass including this instruction (blk.count is bumped after emit)
+		sub_mimm32(blk, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, loop_count), blk.count + 1);
 		blk.jmp_labels.push_back({ "slow_path",
 								   blk.byte_pos,
 								   false,
@@ -1539,8 +1607,8 @@ bool execjit_JALR(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter
 		mov_imm64(blk, rd.host_reg, pc);
 		add_r64imm8(blk, rd.host_reg, 4);
 
-		// Check for loop
-		sub_mimm32(blk, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, loop_count), blk.count);
+		// Check for loop, charges whole pass including this instruction (blk.count is bumped after emit)
+		sub_mimm32(blk, REG_R12, NO_INDEX, 0, offsetof(JIT_HartContext, loop_count), blk.count + 1);
 		blk.jmp_labels.push_back({ "slow_path",
 								   blk.byte_pos,
 								   false,
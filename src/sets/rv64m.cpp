@@ -84,7 +84,7 @@ ExecReturn exec_REMUW(Hart& hart, InstructionData& inst)
 {
 	if((uint32_t)hart.GPR[inst.rs2] == 0)
 	{
-		hart.GPR[inst.rd] = hart.GPR[inst.rs1];
+		hart.GPR[inst.rd] = (uint64_t)(int64_t)(int32_t)hart.GPR[inst.rs1];
 	}
 	else
 	{
@@ -198,3 +198,228 @@ void InstructionDecoder::init_rv64m()
 	register_instr("0000001**********111*****0111011", exec_REMUW);
 	register_instr("0000001**********110*****0111011", exec_REMW);
 }
+#ifdef USE_JIT
+#include "../../include/rvjit/rvjit_x86_64.hpp"
+
+// x0 has no host register
+static void jit_get(JIT_Block& blk, char dest, VReg& src)
+{
+	if(src.vreg == 0)
+		xor_rr(blk, dest, dest);
+	else
+		mov(blk, dest, src.host_reg);
+}
+// Wide multiply and divide work on RDX:RAX, which hold guest registers, so both are saved around the op.
+// rs1 goes to RAX, rs2 to RCX, op leaves its result in RCX
+static void jit_wide_begin(JIT_Block& blk, VReg& rs1, VReg& rs2)
+{
+	push(blk, REG_RAX);
+	push(blk, REG_RDX);
+	jit_get(blk, REG_RCX, rs2);
+	jit_get(blk, REG_RAX, rs1);
+}
+static void jit_wide_end(JIT_Block& blk, VReg& rd, bool word)
+{
+	pop(blk, REG_RDX);
+	pop(blk, REG_RAX);
+	if(word)
+		movsxd(blk, rd.host_reg, REG_RCX);
+	else
+		mov(blk, rd.host_reg, REG_RCX);
+}
+
+bool execjit_MUL(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	emitter.inst_emit_r_type(hart, inst, blk, false, [](JIT_Emitter& em, JIT_Block& blk, VReg& rd, VReg& rs1, VReg& rs2, uint64_t pc, void* tmp)
+	{
+		jit_get(blk, REG_RCX, rs1);
+		if(rs2.vreg == 0)
+			xor_rr(blk, REG_RCX, REG_RCX);
+		else
+			imul_rr(blk, REG_RCX, rs2.host_reg);
+		mov(blk, rd.host_reg, REG_RCX);
+	}, blk.pc + blk.size);
+	return false;
+}
+bool execjit_MULW(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	emitter.inst_emit_r_type(hart, inst, blk, false, [](JIT_Emitter& em, JIT_Block& blk, VReg& rd, VReg& rs1, VReg& rs2, uint64_t pc, void* tmp)
+	{
+		jit_get(blk, REG_RCX, rs1);
+		if(rs2.vreg == 0)
+			xor_rr(blk, REG_RCX, REG_RCX);
+		else
+			imul_rr32(blk, REG_RCX, rs2.host_reg);
+		movsxd(blk, rd.host_reg, REG_RCX);
+	}, blk.pc + blk.size);
+	return false;
+}
+bool execjit_MULH(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	emitter.inst_emit_r_type(hart, inst, blk, false, [](JIT_Emitter& em, JIT_Block& blk, VReg& rd, VReg& rs1, VReg& rs2, uint64_t pc, void* tmp)
+	{
+		jit_wide_begin(blk, rs1, rs2);
+		imul_r(blk, REG_RCX);
+		mov(blk, REG_RCX, REG_RDX);
+		jit_wide_end(blk, rd, false);
+	}, blk.pc + blk.size);
+	return false;
+}
+bool execjit_MULHU(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	emitter.inst_emit_r_type(hart, inst, blk, false, [](JIT_Emitter& em, JIT_Block& blk, VReg& rd, VReg& rs1, VReg& rs2, uint64_t pc, void* tmp)
+	{
+		jit_wide_begin(blk, rs1, rs2);
+		mul_r(blk, REG_RCX);
+		mov(blk, REG_RCX, REG_RDX);
+		jit_wide_end(blk, rd, false);
+	}, blk.pc + blk.size);
+	return false;
+}
+bool execjit_MULHSU(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	emitter.inst_emit_r_type(hart, inst, blk, false, [](JIT_Emitter& em, JIT_Block& blk, VReg& rd, VReg& rs1, VReg& rs2, uint64_t pc, void* tmp)
+	{
+		// Unsigned high part, minus rs2 when rs1 is negative
+		jit_wide_begin(blk, rs1, rs2);
+		push(blk, REG_RAX);
+		mul_r(blk, REG_RCX);
+		pop(blk, REG_RAX);
+		sar_rimm8(blk, REG_RAX, 63);
+		and_rr(blk, REG_RAX, REG_RCX);
+		sub_rr(blk, REG_RDX, REG_RAX);
+		mov(blk, REG_RCX, REG_RDX);
+		jit_wide_end(blk, rd, false);
+	}, blk.pc + blk.size);
+	return false;
+}
+
+struct jit_div_op
+{
+	bool is_signed;
+	bool word;
+	bool rem;
+};
+static bool jit_div(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter, jit_div_op op)
+{
+	emitter.inst_emit_r_type(hart, inst, blk, false, [](JIT_Emitter& em, JIT_Block& blk, VReg& rd, VReg& rs1, VReg& rs2, uint64_t pc, void* tmp)
+	{
+		auto op = *reinterpret_cast<jit_div_op*>(tmp);
+		jit_wide_begin(blk, rs1, rs2);
+
+		// x86 raises #DE where RISC-V gives defined results, those cases never reach DIV
+		if(op.word)
+			test_rr32(blk, REG_RCX, REG_RCX);
+		else
+			test_rr(blk, REG_RCX, REG_RCX);
+		blk.jmp_labels.push_back({ "div_zero", blk.byte_pos, false, 1 });
+		je8(blk, 0);
+
+		if(op.is_signed)
+		{
+			// x / -1 is -x and x % -1 is 0, that covers INT_MIN / -1 too
+			if(op.word)
+				cmp_r32imm8(blk, REG_RCX, -1);
+			else
+				cmp_rimm8(blk, REG_RCX, -1);
+			blk.jmp_labels.push_back({ "div_do", blk.byte_pos, false, 1 });
+			jne8(blk, 0);
+			if(op.rem)
+				xor_rr(blk, REG_RCX, REG_RCX);
+			else
+			{
+				if(op.word)
+					neg_r32(blk, REG_RAX);
+				else
+					neg_r(blk, REG_RAX);
+				mov(blk, REG_RCX, REG_RAX);
+			}
+			blk.jmp_labels.push_back({ "div_end", blk.byte_pos, false, 1 });
+			jmp8(blk, 0);
+
+			em.realize_label(blk, "div_do");
+			if(op.word)
+			{
+				cdq(blk);
+				idiv_r32(blk, REG_RCX);
+			}
+			else
+			{
+				cqo(blk);
+				idiv_r(blk, REG_RCX);
+			}
+		}
+		else
+		{
+			xor_rr(blk, REG_RDX, REG_RDX);
+			if(op.word)
+				div_r32(blk, REG_RCX);
+			else
+				div_r(blk, REG_RCX);
+		}
+		mov(blk, REG_RCX, op.rem ? REG_RDX : REG_RAX);
+		blk.jmp_labels.push_back({ "div_end", blk.byte_pos, false, 1 });
+		jmp8(blk, 0);
+
+		// Division by zero gives all ones and leaves dividend as remainder
+		em.realize_label(blk, "div_zero");
+		if(op.rem)
+			mov(blk, REG_RCX, REG_RAX);
+		else
+			mov_imm32(blk, REG_RCX, -1);
+
+		em.realize_label(blk, "div_end");
+		jit_wide_end(blk, rd, op.word);
+	}, blk.pc + blk.size, &op);
+	return false;
+}
+bool execjit_DIV(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	return jit_div(hart, inst, blk, emitter, { true, false, false });
+}
+bool execjit_DIVU(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	return jit_div(hart, inst, blk, emitter, { false, false, false });
+}
+bool execjit_DIVW(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	return jit_div(hart, inst, blk, emitter, { true, true, false });
+}
+bool execjit_DIVUW(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	return jit_div(hart, inst, blk, emitter, { false, true, false });
+}
+bool execjit_REM(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	return jit_div(hart, inst, blk, emitter, { true, false, true });
+}
+bool execjit_REMU(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	return jit_div(hart, inst, blk, emitter, { false, false, true });
+}
+bool execjit_REMW(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	return jit_div(hart, inst, blk, emitter, { true, true, true });
+}
+bool execjit_REMUW(Hart& hart, InstructionData& inst, JIT_Block& blk, JIT_Emitter& emitter)
+{
+	return jit_div(hart, inst, blk, emitter, { false, true, true });
+}
+
+void JIT_InstructionDecoder::init_rv64m()
+{
+	conversion_tbl[&exec_MUL]	 = &execjit_MUL;
+	conversion_tbl[&exec_MULW]	 = &execjit_MULW;
+	conversion_tbl[&exec_MULH]	 = &execjit_MULH;
+	conversion_tbl[&exec_MULHSU] = &execjit_MULHSU;
+	conversion_tbl[&exec_MULHU]	 = &execjit_MULHU;
+	conversion_tbl[&exec_DIV]	 = &execjit_DIV;
+	conversion_tbl[&exec_DIVU]	 = &execjit_DIVU;
+	conversion_tbl[&exec_DIVW]	 = &execjit_DIVW;
+	conversion_tbl[&exec_DIVUW]	 = &execjit_DIVUW;
+	conversion_tbl[&exec_REM]	 = &execjit_REM;
+	conversion_tbl[&exec_REMU]	 = &execjit_REMU;
+	conversion_tbl[&exec_REMW]	 = &execjit_REMW;
+	conversion_tbl[&exec_REMUW]	 = &execjit_REMUW;
+}
+#endif
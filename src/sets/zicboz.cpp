@@ -23,17 +23,24 @@ ExecReturn exec_cbo_zero(Hart& hart, InstructionData& inst)
 	uint64_t addr = hart.GPR[inst.rs1];
 	// align
 	addr		  = addr & ~63;
+	if(hart.mmu.enabled(hart, AccessType::Write))
+	{
+		// Block is 64 bytes aligned, so it never crosses a page
+		MemoryReturn out = hart.mmu.translate(hart, addr, AccessType::Write, &addr);
+		if(!out.is_success) return { false, false, 4, out.exc_code, out.tval };
+	}
 	if(addr >= 0x80000000)
 	{
 		// Effectively zero the memory
 		memset(hart.mmap->ram_direct->data + (addr - 0x80000000), 0, 64);
+		hart.mmap->mark_dirty(addr, 64);
 	}
 	else
 	{
 		// Fallback for devices
 		for(size_t i = 0; i < 64; ++i)
 		{
-			hart.mmio->write(hart, addr + i, MemorySize::Byte, 0);
+			hart.mmio->write_phys(hart, addr + i, MemorySize::Byte, 0);
 		}
 	}
 	return { true, false, 4, 0, 0 };
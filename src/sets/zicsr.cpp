@@ -154,7 +154,7 @@ ExecReturn exec_CSRRS(Hart& hart, InstructionData& inst)
 	if(inst.rs1 != 0)
 	{
 		uint64_t mask = hart.GPR[inst.rs1];
-		hart.csr_write(inst.imm, init_val | mask);
+		hart.csr_write(inst.imm, hart.csr_read_rmw(inst.imm) | mask);
 	}
 	hart.GPR[inst.rd] = init_val;
 	return { true, false, 4, 0, 0 };
@@ -179,7 +179,7 @@ ExecReturn exec_CSRRC(Hart& hart, InstructionData& inst)
 	if(inst.rs1 != 0)
 	{
 		uint64_t mask = hart.GPR[inst.rs1];
-		hart.csr_write(inst.imm, init_val & ~mask);
+		hart.csr_write(inst.imm, hart.csr_read_rmw(inst.imm) & ~mask);
 	}
 	hart.GPR[inst.rd] = init_val;
 	return { true, false, 4, 0, 0 };
@@ -228,7 +228,7 @@ ExecReturn exec_CSRRSI(Hart& hart, InstructionData& inst)
 	if(inst.rs1 != 0)
 	{
 		uint64_t mask = inst.rs1;
-		hart.csr_write(inst.imm, init_val | mask);
+		hart.csr_write(inst.imm, hart.csr_read_rmw(inst.imm) | mask);
 	}
 	hart.GPR[inst.rd] = init_val;
 	return { true, false, 4, 0, 0 };
@@ -253,7 +253,7 @@ ExecReturn exec_CSRRCI(Hart& hart, InstructionData& inst)
 	if(inst.rs1 != 0)
 	{
 		uint64_t mask = inst.rs1;
-		hart.csr_write(inst.imm, init_val & ~mask);
+		hart.csr_write(inst.imm, hart.csr_read_rmw(inst.imm) & ~mask);
 	}
 	hart.GPR[inst.rd] = init_val;
 	return { true, false, 4, 0, 0 };